@@ -0,0 +1,378 @@
+/*
+ * chebyshev_fit.c - Fit Chebyshev ephemerides to the analytic theories
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <kepler.h>
+#include <vsop87.h>
+#include <elp82b.h>
+#include <pluto.h>
+#include <chebyshev.h>
+
+/* Degree of the polynomials in every segment */
+#define DEGREE		13
+
+/* Number of segments fitted to find the segment length for a body */
+#define PROBES		16
+
+/* Points in each segment where the fit is checked against the theory */
+#define CHECKS		5
+
+/* Shortest segment in days that is tried before the fit is given up */
+#define MIN_LENGTH	(1.0 / 16)
+
+static char *body_names[] = {"Mercury","Venus","Earth","Mars","Jupiter",
+			     "Saturn","Uranus","Neptune","Pluto","Moon"};
+
+/* Initial length of a segment in days for each body */
+static double initial_length[] = {16,32,32,64,256,256,512,512,512,4};
+
+/* Fitted segments of every body */
+static double *coefficients[CHEBYSHEV_BODY_COUNT];
+
+void display_usage()
+{
+    printf("Usage: chebyshev_fit START END ERROR OUTPUT\n");
+    printf("Fit Chebyshev polynomials to the positions of the planets, Pluto"
+	   " & the Moon\nfrom START to END (YYYY-MM-DD, TDB) and write them"
+	   " to OUTPUT for\nchebyshev_open(). The fit is refined until its"
+	   " error is below ERROR KM.\n\n");
+    printf("  -h, --help    display this help screen and exit\n");
+    printf("  -v, --version display version number and exit\n");
+}
+
+void parse_command_line(int argc, char *argv[], struct julian_date *start,
+			struct julian_date *end, double *error)
+{
+    int year,month,day;
+
+    if (argc > 1) {
+	if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+	    display_usage();
+	    exit(0);
+	}
+
+	if (!strcmp(argv[1], "-v") || !strcmp(argv[1], "--version")) {
+	    printf(PROG_VERSION_STRING);
+	    printf(PROG_COPYRIGHT);
+	    exit(0);
+	}
+    }
+
+    if (argc != 5) {
+	display_usage();
+	exit(1);
+    }
+
+    if (sscanf(argv[1], "%d-%d-%d", &year, &month, &day) != 3 ||
+	calendar_to_julian_date(year, month, day, start) != SUCCESS ||
+	sscanf(argv[2], "%d-%d-%d", &year, &month, &day) != 3 ||
+	calendar_to_julian_date(year, month, day, end) != SUCCESS ||
+	end->date1 + end->date2 <= start->date1 + start->date2) {
+	fprintf(stderr, "Invalid dates %s %s\n", argv[1], argv[2]);
+	exit(1);
+    }
+
+    *error = atof(argv[3]);
+    if (*error <= 0) {
+	fprintf(stderr, "Invalid error %s\n", argv[3]);
+	exit(1);
+    }
+}
+
+/*
+ * Calculates the position of a body with its theory.
+ *
+ * body -- A planet, CHEBYSHEV_PLUTO or CHEBYSHEV_MOON.
+ * jd -- The epoch (TDB).
+ * pos -- The position in the units of the body.
+ *
+ * Return: SUCCESS or an error code from the theory.
+ */
+int body_position(int body, double jd, struct rectangular_coordinates *pos)
+{
+    struct julian_date tdb;
+
+    tdb.date1 = jd;
+    tdb.date2 = 0;
+    if (body == CHEBYSHEV_MOON) {
+	elp82b_coordinates(&tdb, pos);
+	return SUCCESS;
+    }
+    if (body == CHEBYSHEV_PLUTO)
+	return pluto_coordinates(&tdb, pos);
+
+    return vsop87_coordinates(body, &tdb, pos);
+}
+
+/*
+ * Fits a segment and checks it against the theory at CHECKS points,
+ * including both ends.
+ *
+ * body -- The body to be fitted.
+ * start -- The Julian date (TDB) the segment starts.
+ * length -- The length of the segment in days.
+ * c -- The coefficients of x, y & z, DEGREE + 1 each.
+ *
+ * Return: The largest error of the fit in the units of the body, or -1 if
+ *         the theory could not be evaluated.
+ */
+double fit_segment(int body, double start, double length, double *c)
+{
+    int i,j,k,n = DEGREE + 1;
+    double x,tau,t0,t1,t2,err,p[3],f[DEGREE + 1][3];
+    struct rectangular_coordinates pos;
+
+    /* Sample the theory at the Chebyshev nodes */
+    for (j = 0; j < n; j++) {
+	tau = cos(PI * (j + 0.5) / n);
+	if (body_position(body, start + (tau + 1) * length / 2, &pos))
+	    return -1;
+	f[j][0] = pos.x;
+	f[j][1] = pos.y;
+	f[j][2] = pos.z;
+    }
+
+    for (i = 0; i < 3; i++) {
+	for (k = 0; k < n; k++) {
+	    x = 0;
+	    for (j = 0; j < n; j++)
+		x += f[j][i] * cos(PI * k * (j + 0.5) / n);
+	    c[i * n + k] = x * (k ? 2.0 : 1.0) / n;
+	}
+    }
+
+    err = 0;
+    for (j = 0; j < CHECKS; j++) {
+	tau = -1 + 2.0 * j / (CHECKS - 1);
+	if (body_position(body, start + (tau + 1) * length / 2, &pos))
+	    return -1;
+
+	for (i = 0; i < 3; i++) {
+	    t0 = 1;
+	    t1 = tau;
+	    p[i] = c[i * n];
+	    for (k = 1; k < n; k++) {
+		p[i] += c[i * n + k] * t1;
+		t2 = 2 * tau * t1 - t0;
+		t0 = t1;
+		t1 = t2;
+	    }
+	}
+
+	err = fmax(err, sqrt((p[0] - pos.x) * (p[0] - pos.x) +
+			     (p[1] - pos.y) * (p[1] - pos.y) +
+			     (p[2] - pos.z) * (p[2] - pos.z)));
+    }
+
+    return err;
+}
+
+/*
+ * Fits a body over a time span. The number of segments is first chosen by
+ * fitting PROBES segments spread over the span, and doubled until every
+ * segment of the full fit is within the error bound. The fit is given up
+ * rather than make the segments shorter than MIN_LENGTH, below which the
+ * error is rounding in the theory and does not go down any further.
+ *
+ * body -- The body to be fitted.
+ * start -- The Julian date (TDB) the span starts.
+ * span -- The length of the span in days.
+ * error -- The largest acceptable error in the units of the body.
+ * fb -- The segments & error of the fit.
+ *
+ * Return: SUCCESS -- If the body has been fitted.
+ *         ERR_INVALID_DATE -- If the span is outside the range of the theory.
+ *         ERR_CONVERGENCE -- If the error bound cannot be reached.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated.
+ */
+int fit_body(int body, double start, double span, double error,
+	     struct chebyshev_file_body *fb)
+{
+    int i,k,n,segments,fits;
+    double length,err,worst,c[3 * (DEGREE + 1)];
+
+    n = 3 * (DEGREE + 1);
+    segments = (int)ceil(span / initial_length[body]);
+
+    /* Halve the segments while the probes fit, then double until they do */
+    for (fits = -1; ; ) {
+	length = span / segments;
+	worst = 0;
+	for (i = 0; i < PROBES; i++) {
+	    k = (int)((double)i * segments / PROBES);
+	    if (i && k == (int)((double)(i - 1) * segments / PROBES))
+		continue;
+	    err = fit_segment(body, start + k * length, length, c);
+	    if (err < 0)
+		return ERR_INVALID_DATE;
+	    worst = fmax(worst, err);
+	}
+
+	if (worst <= error / 2) {
+	    if (fits == 0 || segments == 1)
+		break;
+	    fits = 1;
+	    segments = (segments + 1) / 2;
+	} else {
+	    if (fits == 1) {
+		segments *= 2;
+		break;
+	    }
+	    if (length < 2 * MIN_LENGTH || segments > INT_MAX / 2)
+		return ERR_CONVERGENCE;
+	    fits = 0;
+	    segments *= 2;
+	}
+    }
+
+    for (;;) {
+	free(coefficients[body]);
+	coefficients[body] = malloc((size_t)segments * n * sizeof(double));
+	if (!coefficients[body])
+	    return ERR_UNSUPPORTED;
+
+	length = span / segments;
+	worst = 0;
+	for (k = 0; k < segments && worst <= error; k++) {
+	    err = fit_segment(body, start + k * length, length,
+			      coefficients[body] + (size_t)k * n);
+	    if (err < 0)
+		return ERR_INVALID_DATE;
+	    worst = fmax(worst, err);
+	}
+
+	if (worst <= error)
+	    break;
+	if (length < 2 * MIN_LENGTH || segments > INT_MAX / 2)
+	    return ERR_CONVERGENCE;
+	segments *= 2;
+    }
+
+    fb->degree = DEGREE;
+    fb->segments = segments;
+    fb->start = start;
+    fb->length = length;
+    fb->error = worst;
+
+    return SUCCESS;
+}
+
+/*
+ * Writes the ephemeris file.
+ *
+ * path -- The file to be written.
+ * header -- The file header with the fitted bodies.
+ *
+ * Return: SUCCESS -- If the file has been written successfully.
+ *         ERR_FILE_ACCESS -- If the file could not be written.
+ */
+int write_file(char *path, struct chebyshev_file_header *header)
+{
+    FILE *fp;
+    int i,n;
+    int64_t offset;
+    struct chebyshev_file_body *fb;
+    static const char zeros[CHEBYSHEV_FILE_ALIGNMENT] = {0};
+
+    memcpy(header->magic, CHEBYSHEV_FILE_MAGIC, sizeof(CHEBYSHEV_FILE_MAGIC));
+    header->format = CHEBYSHEV_FILE_FORMAT;
+    header->byte_order = CHEBYSHEV_FILE_BYTE_ORDER;
+
+    /* Lay out the segments of every body after the header */
+    offset = sizeof(*header);
+    for (i = 0; i < CHEBYSHEV_BODY_COUNT; i++) {
+	fb = &header->body[i];
+	if (!(header->bodies & (1 << i)))
+	    continue;
+
+	offset = (offset + CHEBYSHEV_FILE_ALIGNMENT - 1) /
+	    CHEBYSHEV_FILE_ALIGNMENT * CHEBYSHEV_FILE_ALIGNMENT;
+	fb->offset = offset;
+	offset += (int64_t)fb->segments * 3 * (fb->degree + 1) * sizeof(double);
+    }
+
+    fp = fopen(path, "wb");
+    if (!fp)
+	return ERR_FILE_ACCESS;
+
+    fwrite(header, sizeof(*header), 1, fp);
+    offset = sizeof(*header);
+    for (i = 0; i < CHEBYSHEV_BODY_COUNT; i++) {
+	fb = &header->body[i];
+	if (!(header->bodies & (1 << i)))
+	    continue;
+
+	n = fb->segments * 3 * (fb->degree + 1);
+	fwrite(zeros, 1, fb->offset - offset, fp);
+	fwrite(coefficients[i], sizeof(double), n, fp);
+	offset = fb->offset + n * sizeof(double);
+    }
+
+    i = ferror(fp);
+    if (fclose(fp) || i)
+	return ERR_FILE_ACCESS;
+
+    return SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    int i,retval;
+    double span,error,unit;
+    struct julian_date start,end;
+    struct chebyshev_file_header header;
+
+    parse_command_line(argc, argv, &start, &end, &error);
+    span = (end.date1 + end.date2) - (start.date1 + start.date2);
+
+    memset(&header, 0, sizeof(header));
+    printf("Body, segments, days per segment, largest error (KM)\n\n");
+    for (i = 0; i < CHEBYSHEV_BODY_COUNT; i++) {
+	unit = (i == CHEBYSHEV_MOON) ? 1 : AU;
+	retval = fit_body(i, start.date1 + start.date2, span, error / unit,
+			  &header.body[i]);
+	if (retval == ERR_INVALID_DATE) {
+	    printf("%10s: skipped, dates out of range for the theory\n",
+		   body_names[i]);
+	    continue;
+	} else if (retval == ERR_CONVERGENCE) {
+	    fprintf(stderr, "%s: an error of %g KM cannot be reached\n",
+		    body_names[i], error);
+	    return(1);
+	} else if (retval != SUCCESS) {
+	    fprintf(stderr, "Out of memory\n");
+	    return(1);
+	}
+
+	header.bodies |= 1 << i;
+	printf("%10s: %8d, %8.3f, %8.2e\n", body_names[i],
+	       header.body[i].segments, header.body[i].length,
+	       header.body[i].error * unit);
+    }
+
+    if (write_file(argv[4], &header) != SUCCESS) {
+	fprintf(stderr, "%s: cannot be written\n", argv[4]);
+	return(1);
+    }
+
+    return(0);
+}
@@ -34,6 +34,7 @@
 #include <eclipse.h>
 #include <equisols.h>
 #include <earth_figure.h>
+#include <chebyshev.h>
 
 void display_usage()
 {
@@ -64,21 +65,119 @@ void parse_command_line(int argc, char *argv[], int *show_all)
     }
 }
 
+/* The built-in VSOP87 (version A) tables, see src/vsop87_data.c */
+extern const struct vsop87_series planets_series[];
+
+/*
+ * Writes the built-in VSOP87 tables of the planets to a table file for
+ * vsop87_load(), laid out the way examples/vsop87_convert writes them.
+ *
+ * path -- The file to be written.
+ * version -- The version of the theory recorded in the header.
+ * cut -- The number of bytes left out at the end of the file.
+ *
+ * Return: SUCCESS -- If the file has been written successfully.
+ *         ERR_FILE_ACCESS -- If the file could not be written.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated.
+ */
+int write_vsop87_table(const char *path, char version, size_t cut)
+{
+    FILE *fp;
+    int i,j,retval;
+    size_t size;
+    char *buf;
+    double *a;
+    struct vsop87_file_header header;
+    struct vsop87_file_series *fs;
+    const struct vsop87_series *s;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VSOP87_FILE_MAGIC, sizeof(VSOP87_FILE_MAGIC));
+    header.format = VSOP87_FILE_FORMAT;
+    header.byte_order = VSOP87_FILE_BYTE_ORDER;
+    header.version = version;
+    header.bodies = VSOP87_ALL_PLANETS;
+
+    /* Lay out the series of every planet after the header */
+    size = sizeof(header);
+    for (i = MERCURY; i <= NEPTUNE; i++) {
+	for (j = 0; j < VSOP87_SERIES_PER_BODY; j++) {
+	    s = &planets_series[i * VSOP87_SERIES_PER_BODY + j];
+	    fs = &header.series[i][j];
+	    if (!s->count)
+		continue;
+
+	    fs->count = s->count;
+	    fs->padded = (s->count + VSOP87_TERM_PADDING - 1) /
+		VSOP87_TERM_PADDING * VSOP87_TERM_PADDING;
+	    size = (size + VSOP87_TERM_ALIGNMENT - 1) /
+		VSOP87_TERM_ALIGNMENT * VSOP87_TERM_ALIGNMENT;
+	    fs->offset = size;
+	    size += 3 * fs->padded * sizeof(double);
+	}
+    }
+
+    buf = calloc(1, size);
+    if (!buf)
+	return ERR_UNSUPPORTED;
+
+    memcpy(buf, &header, sizeof(header));
+    for (i = MERCURY; i <= NEPTUNE; i++) {
+	for (j = 0; j < VSOP87_SERIES_PER_BODY; j++) {
+	    s = &planets_series[i * VSOP87_SERIES_PER_BODY + j];
+	    fs = &header.series[i][j];
+	    if (!s->count)
+		continue;
+
+	    a = (double *)(buf + fs->offset);
+	    memcpy(a, s->a, s->count * sizeof(double));
+	    memcpy(a + fs->padded, s->b, s->count * sizeof(double));
+	    memcpy(a + 2 * fs->padded, s->c, s->count * sizeof(double));
+	}
+    }
+
+    retval = ERR_FILE_ACCESS;
+    fp = fopen(path, "wb");
+    if (fp) {
+	if (fwrite(buf, 1, size - cut, fp) == size - cut)
+	    retval = SUCCESS;
+	if (fclose(fp))
+	    retval = ERR_FILE_ACCESS;
+    }
+
+    free(buf);
+    return retval;
+}
+
 int main(int argc, char *argv[])
 {
     FILE *fp;
-    int i,year,month,day,retval,show_all;
+    int i,j,k,year,month,day,retval,show_all;
     struct julian_date jd;
     struct equatorial_coordinates eq;
     struct rectangular_coordinates xyz[9],zero = {0, 0, 0},moon;
     struct mpc_body inf;
     double dist,df,epsilon,d_psi,d_eps,prec_matrix[3][3],nut_matrix[3][3],
-	mst,ast,d_ra,d_dec,gamma,u,inb,fib,lon,lat;
+	mst,ast,d_ra,d_dec,gamma,u,inb,fib,lon,lat,diff,
+	tol,bound;
     char buf[256];
     static char *planet_names[] = {"Mercury","Venus","Earth","Mars",
 				   "Jupiter","Saturn","Uranus","Neptune",
 				   "Pluto"};
     static char *mpc_files[] = {"MPCORB.DAT", "COMET.DAT"};
+    static char *kernel_names[] = {"Scalar","SSE2","AVX2","AVX-512",
+				   "Reproducible","Generated"};
+    enum vsop87_kernel kernel;
+    struct rectangular_coordinates ref,vel,earth,samples[4],ref_vel;
+    unsigned long hits,misses;
+    struct julian_date epochs[VSOP87_BLOCK_SIZE];
+    struct rectangular_coordinates batch[VSOP87_BLOCK_SIZE];
+    struct vsop87_stepper stepper;
+    struct pluto_stepper pluto_stepper;
+    struct vsop87_snapshot snap;
+    struct chebyshev_ephemeris *eph;
+    struct vsop87_table *table;
+    double var[3],rate[3];
 
     parse_command_line(argc, argv, &show_all);
 
@@ -118,6 +217,509 @@ int main(int argc, char *argv[])
 	       planet_names[i], xyz[i].x, xyz[i].y, xyz[i].z);
     }
 
+    kernel = vsop87_get_kernel();
+    printf("\nLargest difference between VSOP87 kernels and the scalar"
+	   " kernel from -2000 to 6000 (tolerance %g AU)\n\n",
+	   VSOP87_KERNEL_TOLERANCE);
+    for (k = VSOP87_KERNEL_SSE2; k <= VSOP87_KERNEL_GENERATED; k++) {
+	if (vsop87_set_kernel(k) != SUCCESS) {
+	    printf("%10s: not supported\n", kernel_names[k]);
+	    continue;
+	}
+
+	diff = 0;
+	for (i = MERCURY; i <= NEPTUNE; i++) {
+	    for (j = -40; j <= 40; j++) {
+		jd.date1 = J2000_EPOCH + j * 36524.9;
+		jd.date2 = 0;
+		vsop87_set_kernel(VSOP87_KERNEL_SCALAR);
+		vsop87_coordinates(i, &jd, &ref);
+		vsop87_set_kernel(k);
+		vsop87_coordinates(i, &jd, &moon);
+		diff = fmax(diff, fabs(moon.x - ref.x));
+		diff = fmax(diff, fabs(moon.y - ref.y));
+		diff = fmax(diff, fabs(moon.z - ref.z));
+	    }
+	}
+
+	printf("%10s: %8.2e AU %s\n", kernel_names[k], diff,
+	       diff <= VSOP87_KERNEL_TOLERANCE ? "OK" : "FAILED");
+    }
+    vsop87_set_kernel(kernel);
+
+    /* The generated ELP82B kernel sums the same terms in another order */
+    if (elp82b_set_kernel(VSOP87_KERNEL_GENERATED) == SUCCESS) {
+	diff = 0;
+	for (j = -40; j <= 40; j++) {
+	    jd.date1 = J2000_EPOCH + j * 36524.9;
+	    jd.date2 = 0;
+	    elp82b_set_kernel(VSOP87_KERNEL_SCALAR);
+	    elp82b_coordinates(&jd, &ref);
+	    elp82b_set_kernel(VSOP87_KERNEL_GENERATED);
+	    elp82b_coordinates(&jd, &moon);
+	    diff = fmax(diff, fabs(moon.x - ref.x));
+	    diff = fmax(diff, fabs(moon.y - ref.y));
+	    diff = fmax(diff, fabs(moon.z - ref.z));
+	}
+
+	printf("%10s: %8.2e KM %s (tolerance 1e-06 KM)\n", "Moon", diff,
+	       diff <= 1E-6 ? "OK" : "FAILED");
+	elp82b_set_kernel(kernel);
+    }
+
+    jd.date1 = 2451545.0;
+    jd.date2 = 0;
+    diff = 0;
+    if (vsop87_stepper_init(&stepper, EARTH, &jd, 1.0) == SUCCESS) {
+	for (j = 0; j < 100000; j++) {
+	    vsop87_stepper_next(&stepper, &moon);
+	    if (j % 1000 == 999) {
+		jd.date2 = j;
+		vsop87_coordinates(EARTH, &jd, &ref);
+		diff = fmax(diff, fabs(moon.x - ref.x));
+		diff = fmax(diff, fabs(moon.y - ref.y));
+		diff = fmax(diff, fabs(moon.z - ref.z));
+	    }
+	}
+	vsop87_stepper_free(&stepper);
+    }
+    printf("\nLargest difference between the VSOP87 stepper and"
+	   " vsop87_coordinates over 100000 daily steps for the Earth\n\n");
+    printf("%10s: %8.2e AU %s\n", "Stepper", diff,
+	   diff <= VSOP87_STEPPER_TOLERANCE ? "OK" : "FAILED");
+
+    jd.date1 = PLUTO_MIN_DATE;
+    jd.date2 = 0;
+    diff = 0;
+    if (pluto_stepper_init(&pluto_stepper, &jd, 1.0) == SUCCESS) {
+	for (j = 0; pluto_stepper_next(&pluto_stepper, &moon) == SUCCESS;
+	     j++) {
+	    if (j % 1000 == 999) {
+		jd.date2 = j;
+		pluto_coordinates(&jd, &ref);
+		diff = fmax(diff, fabs(moon.x - ref.x));
+		diff = fmax(diff, fabs(moon.y - ref.y));
+		diff = fmax(diff, fabs(moon.z - ref.z));
+	    }
+	}
+    }
+    printf("\nLargest difference between the Pluto stepper and"
+	   " pluto_coordinates over daily steps from 1700 to 2100\n\n");
+    printf("%10s: %8.2e AU %s\n", "Stepper", diff,
+	   diff <= PLUTO_STEPPER_TOLERANCE ? "OK" : "FAILED");
+
+    printf("\nLargest difference between VSOP87 analytic velocities and"
+	   " central differences of 0.01 days from 1000 to 3000\n(tolerance"
+	   " 2e-09 AU/day, the truncation error of the differences for"
+	   " Mercury)\n\n");
+    for (i = MERCURY; i <= NEPTUNE; i++) {
+	diff = 0;
+	for (j = -10; j <= 10; j++) {
+	    jd.date1 = J2000_EPOCH + j * 36524.9;
+	    jd.date2 = 0;
+	    vsop87_state(i, &jd, &moon, &vel);
+	    jd.date2 = 0.005;
+	    vsop87_coordinates(i, &jd, &ref);
+	    jd.date2 = -0.005;
+	    vsop87_coordinates(i, &jd, &moon);
+	    diff = fmax(diff, fabs((ref.x - moon.x) / 0.01 - vel.x));
+	    diff = fmax(diff, fabs((ref.y - moon.y) / 0.01 - vel.y));
+	    diff = fmax(diff, fabs((ref.z - moon.z) / 0.01 - vel.z));
+	}
+
+	printf("%10s: %8.2e AU/day %s\n", planet_names[i], diff,
+	       diff <= 2E-9 ? "OK" : "FAILED");
+    }
+
+    printf("\nLargest difference between ELP82B analytic velocities and"
+	   " 5-point differences of 0.01 days from -2000 to 6000\n\n");
+    diff = 0;
+    for (j = -40; j <= 40; j++) {
+	jd.date1 = J2000_EPOCH + j * 36524.9;
+	jd.date2 = 0;
+	elp82b_state(&jd, &moon, &vel);
+	elp82b_coordinates(&jd, &ref);
+	diff = fmax(diff, fabs(moon.x - ref.x) + fabs(moon.y - ref.y) +
+		    fabs(moon.z - ref.z));
+	for (k = 0; k < 4; k++) {
+	    jd.date2 = (k < 2 ? k - 2 : k - 1) * 0.01;
+	    elp82b_coordinates(&jd, &samples[k]);
+	}
+	diff = fmax(diff, fabs((samples[0].x - 8 * samples[1].x +
+				8 * samples[2].x - samples[3].x) / 0.12 - vel.x));
+	diff = fmax(diff, fabs((samples[0].y - 8 * samples[1].y +
+				8 * samples[2].y - samples[3].y) / 0.12 - vel.y));
+	diff = fmax(diff, fabs((samples[0].z - 8 * samples[1].z +
+				8 * samples[2].z - samples[3].z) / 0.12 - vel.z));
+    }
+    printf("%10s: %8.2e KM/day %s\n", "Moon", diff,
+	   diff <= 1E-6 ? "OK" : "FAILED");
+
+    /* The worker pool adds up the same sums in the same order */
+    diff = 0;
+    for (k = 2; k <= 4; k++) {
+	if (elp82b_set_threads(k) != SUCCESS) {
+	    diff = 1;
+	    break;
+	}
+	for (j = -5; j <= 5; j++) {
+	    jd.date1 = J2000_EPOCH + j * 36524.9;
+	    jd.date2 = 0.3;
+	    elp82b_coordinates(&jd, &moon);
+	    elp82b_set_threads(0);
+	    elp82b_coordinates(&jd, &ref);
+	    elp82b_set_threads(k);
+	    diff = fmax(diff, fabs(moon.x - ref.x) + fabs(moon.y - ref.y) +
+			fabs(moon.z - ref.z));
+	}
+    }
+    elp82b_set_threads(0);
+    printf("\nELP82B with 2 to 4 threads against one thread: %s\n",
+	   diff == 0 ? "OK" : "FAILED");
+
+    /*
+     * Three passes over two segments of a cache that holds two, then a
+     * third segment that replaces the least recently used first one.
+     */
+    diff = 0;
+    df = 0;
+    chebyshev_moon_cache(2, 1E-3);
+    for (k = 0; k < 7; k++) {
+	jd.date1 = J2000_EPOCH;
+	jd.date2 = k < 6 ? (k % 2) * CHEBYSHEV_MOON_SEGMENT + 0.3 * k :
+	    2 * CHEBYSHEV_MOON_SEGMENT + 1;
+	chebyshev_moon(&jd, &moon, &vel);
+	elp82b_state(&jd, &ref, &ref_vel);
+	diff = fmax(diff, sqrt((moon.x - ref.x) * (moon.x - ref.x) +
+			       (moon.y - ref.y) * (moon.y - ref.y) +
+			       (moon.z - ref.z) * (moon.z - ref.z)));
+	df = fmax(df, fabs(vel.x - ref_vel.x) + fabs(vel.y - ref_vel.y) +
+		  fabs(vel.z - ref_vel.z));
+    }
+    jd.date2 = 1;
+    chebyshev_moon(&jd, &moon, NULL);
+    chebyshev_moon_cache_stats(&hits, &misses);
+    printf("\nMoon segment cache against ELP82B within 1E-3 KM: %8.2e KM"
+	   " %8.2e KM/day,\n%lu hits, %lu misses %s\n", diff, df, hits, misses,
+	   diff <= 1E-3 && df <= 0.1 && misses == 4 ? "OK" : "FAILED");
+
+    /* Eight days fitted by chebyshev_fit within 0.01 KM and read back */
+    diff = -1;
+    df = 0;
+    if (system("./chebyshev_fit 2000-01-01 2000-01-09 0.01 kepler_test.eph"
+	       " > kepler_test.out") == 0 &&
+	chebyshev_open("kepler_test.eph", &eph) == SUCCESS) {
+	diff = 0;
+	for (i = 0; i < CHEBYSHEV_BODY_COUNT; i++) {
+	    for (j = 0; j < 32; j++) {
+		jd.date1 = 2451544.5;
+		jd.date2 = j * 0.25 + 0.1;
+		if (chebyshev_state(eph, i, &jd, &moon, &vel) != SUCCESS) {
+		    diff = 1;
+		    break;
+		}
+		if (i == CHEBYSHEV_MOON) {
+		    elp82b_state(&jd, &ref, &ref_vel);
+		    u = 1;
+		} else if (i == CHEBYSHEV_PLUTO) {
+		    pluto_coordinates(&jd, &ref);
+		    ref_vel = vel;
+		    u = AU;
+		} else {
+		    vsop87_state(i, &jd, &ref, &ref_vel);
+		    u = AU;
+		}
+		diff = fmax(diff, u * sqrt((moon.x - ref.x) * (moon.x - ref.x) +
+					   (moon.y - ref.y) * (moon.y - ref.y) +
+					   (moon.z - ref.z) * (moon.z - ref.z)));
+		df = fmax(df, u * (fabs(vel.x - ref_vel.x) +
+				   fabs(vel.y - ref_vel.y) +
+				   fabs(vel.z - ref_vel.z)));
+	    }
+	}
+	chebyshev_close(eph);
+    }
+    remove("kepler_test.eph");
+    remove("kepler_test.out");
+    printf("\nChebyshev ephemeris fitted within 0.01 KM against the theories:"
+	   " %8.2e KM %8.2e KM/day %s\n", diff, df,
+	   diff >= 0 && diff <= 0.01 && df <= 0.1 ? "OK" : "FAILED");
+
+    /*
+     * The built-in tables written to a file and mapped back, then a file
+     * cut short by 100 bytes & a file of another version
+     */
+    diff = -1;
+    k = 0;
+    retval = write_vsop87_table("kepler_test.vsop", 'A', 0);
+    if (retval == SUCCESS)
+	retval = vsop87_load("kepler_test.vsop", 'A', &table);
+    if (retval == SUCCESS) {
+	diff = 0;
+	for (i = MERCURY; i <= NEPTUNE; i++) {
+	    for (j = -10; j <= 10; j++) {
+		jd.date1 = J2000_EPOCH + j * 36524.9;
+		jd.date2 = 0.3;
+		vsop87_table_state(table, i, &jd, var, rate);
+		vsop87_state(i, &jd, &ref, &vel);
+		diff = fmax(diff, fabs(var[0] - ref.x) + fabs(var[1] - ref.y) +
+			    fabs(var[2] - ref.z));
+		diff = fmax(diff, fabs(rate[0] - vel.x) +
+			    fabs(rate[1] - vel.y) + fabs(rate[2] - vel.z));
+	    }
+	}
+	vsop87_unload(table);
+
+	if (write_vsop87_table("kepler_test.vsop", 'A', 100) == SUCCESS &&
+	    (retval = vsop87_load("kepler_test.vsop", 'A', &table)) ==
+	    SUCCESS)
+	    vsop87_unload(table);
+	k += retval == ERR_INVALID_DATA;
+
+	if (write_vsop87_table("kepler_test.vsop", 'A', 0) == SUCCESS &&
+	    (retval = vsop87_load("kepler_test.vsop", 'B', &table)) ==
+	    SUCCESS)
+	    vsop87_unload(table);
+	k += retval == ERR_INVALID_DATA;
+	retval = SUCCESS;
+    }
+    remove("kepler_test.vsop");
+    if (retval == ERR_UNSUPPORTED) {
+	printf("\nVSOP87 tables loaded from a file: not supported\n");
+    } else {
+	printf("\nVSOP87 tables loaded from a file against the built-in"
+	       " tables: %8.2e %s\n", diff, diff == 0 ? "OK" : "FAILED");
+	printf("VSOP87 tables cut short or of another version rejected: %s\n",
+	       k == 2 ? "OK" : "FAILED");
+    }
+
+    printf("\nLargest difference between vsop87_geocentric_apparent and"
+	   " a converged light-time\niteration from 1000 to 3000\n\n");
+    for (i = MERCURY; i <= NEPTUNE; i++) {
+	if (i == EARTH)
+	    continue;
+
+	diff = 0;
+	for (j = -100; j <= 100; j++) {
+	    jd.date1 = J2000_EPOCH + j * 3652.49;
+	    jd.date2 = 0;
+	    vsop87_geocentric_apparent(i, &jd, &moon, &dist);
+	    vsop87_coordinates(EARTH, &jd, &earth);
+	    df = 0;
+	    for (k = 0; k < 6; k++) {
+		jd.date2 = -df;
+		vsop87_coordinates(i, &jd, &ref);
+		ref.x -= earth.x;
+		ref.y -= earth.y;
+		ref.z -= earth.z;
+		df = sqrt(ref.x * ref.x + ref.y * ref.y + ref.z * ref.z) /
+		    C_AUPERDAY;
+	    }
+	    diff = fmax(diff, fabs(moon.x - ref.x) + fabs(moon.y - ref.y) +
+			fabs(moon.z - ref.z));
+	    diff = fmax(diff, fabs(dist - df * C_AUPERDAY));
+	}
+
+	printf("%10s: %8.2e AU %s\n", planet_names[i], diff,
+	       diff <= VSOP87_LIGHT_TIME_TOLERANCE ? "OK" : "FAILED");
+    }
+
+    jd.date1 = 2455200.50;
+    jd.date2 = 0;
+    diff = 0;
+    vsop87_snapshot(&jd, VSOP87_ALL_PLANETS, VSOP87_SNAPSHOT_VELOCITY |
+		    VSOP87_SNAPSHOT_THREADS, &snap);
+    for (i = MERCURY; i <= NEPTUNE; i++) {
+	vsop87_state(i, &jd, &ref, &vel);
+	diff = fmax(diff, fabs(snap.pos[i].x - ref.x));
+	diff = fmax(diff, fabs(snap.pos[i].y - ref.y));
+	diff = fmax(diff, fabs(snap.pos[i].z - ref.z));
+	diff = fmax(diff, fabs(snap.vel[i].x - vel.x));
+	diff = fmax(diff, fabs(snap.vel[i].y - vel.y));
+	diff = fmax(diff, fabs(snap.vel[i].z - vel.z));
+    }
+    printf("\nThreaded VSOP87 snapshot of all planets against"
+	   " vsop87_state: %s\n", diff == 0 ? "OK" : "FAILED");
+
+    /* Three passes over 8 epochs, the last two answered from the cache */
+    diff = 0;
+    vsop87_earth_cache(8);
+    for (k = 0; k < 3; k++) {
+	for (j = 0; j < 8; j++) {
+	    jd.date1 = J2000_EPOCH + j * 3652.5;
+	    jd.date2 = 0.25;
+	    vsop87_coordinates(EARTH, &jd, &moon);
+	    vsop87_coordinates_batch(EARTH, &jd, 1, &ref);
+	    diff = fmax(diff, fabs(moon.x - ref.x) + fabs(moon.y - ref.y) +
+			fabs(moon.z - ref.z));
+	}
+    }
+    vsop87_earth_cache_stats(&hits, &misses);
+    vsop87_earth_cache(0);
+    printf("\nEarth cache: %lu hits, %lu misses %s\n", hits, misses,
+	   diff == 0 && hits == 16 && misses == 8 ? "OK" : "FAILED");
+
+    printf("\nTruncated VSOP87 against the full theory and its error"
+	   " bound from 1000 to 3000\n\n");
+    for (tol = 1E-4; tol >= 1E-10; tol /= 100) {
+	diff = 0;
+	for (i = MERCURY; i <= NEPTUNE; i++) {
+	    for (j = -10; j <= 10; j++) {
+		jd.date1 = J2000_EPOCH + j * 36524.9;
+		jd.date2 = 0;
+		vsop87_coordinates(i, &jd, &ref);
+		vsop87_coordinates_tol(i, &jd, tol, &moon, &bound);
+		diff = fmax(diff, fabs(moon.x - ref.x) - bound);
+		diff = fmax(diff, fabs(moon.y - ref.y) - bound);
+		diff = fmax(diff, fabs(moon.z - ref.z) - bound);
+		diff = fmax(diff, bound - tol);
+	    }
+	}
+
+	printf("%10g: %s\n", tol,
+	       diff <= VSOP87_KERNEL_TOLERANCE ? "OK" : "FAILED");
+    }
+
+    printf("\nTruncated ELP82B against the full theory and its error"
+	   " bound from 1000 to 3000\n\n");
+    for (tol = 10; tol >= 1E-3; tol /= 10) {
+	diff = 0;
+	for (j = -10; j <= 10; j++) {
+	    jd.date1 = J2000_EPOCH + j * 36524.9;
+	    jd.date2 = 0;
+	    elp82b_coordinates(&jd, &ref);
+	    elp82b_coordinates_tol(&jd, tol, &moon, &bound);
+
+	    /* The direction within the longitude & latitude errors */
+	    dist = sqrt(ref.x * ref.x + ref.y * ref.y + ref.z * ref.z);
+	    u = sqrt(moon.x * moon.x + moon.y * moon.y + moon.z * moon.z);
+	    df = sqrt(pow(ref.y * moon.z - ref.z * moon.y, 2) +
+		      pow(ref.z * moon.x - ref.x * moon.z, 2) +
+		      pow(ref.x * moon.y - ref.y * moon.x, 2)) / (dist * u);
+	    diff = fmax(diff, df * RAD_TO_ACS - sqrt(2) * bound);
+
+	    /* The distance within the error at 385000 KM */
+	    diff = fmax(diff, fabs(u - dist) / (ACS_TO_RAD * 385000) - bound);
+	    diff = fmax(diff, bound - tol);
+	}
+
+	printf("%10g: %s\n", tol, diff <= 1E-6 ? "OK" : "FAILED");
+    }
+
+    printf("\nLargest difference between single precision VSOP87 & ELP82B"
+	   " and the full theories from -2000 to 6000 (tolerance %g AU)\n\n",
+	   VSOP87_FAST_TOLERANCE);
+    for (i = MERCURY; i <= NEPTUNE; i++) {
+	diff = 0;
+	for (j = -40; j <= 40; j++) {
+	    jd.date1 = J2000_EPOCH + j * 36524.9;
+	    jd.date2 = 0;
+	    vsop87_coordinates(i, &jd, &ref);
+	    vsop87_coordinates_fast(i, &jd, 1, &moon);
+	    diff = fmax(diff, fabs(moon.x - ref.x));
+	    diff = fmax(diff, fabs(moon.y - ref.y));
+	    diff = fmax(diff, fabs(moon.z - ref.z));
+	}
+
+	printf("%10s: %8.2e AU %s\n", planet_names[i], diff,
+	       diff <= VSOP87_FAST_TOLERANCE ? "OK" : "FAILED");
+    }
+
+    diff = 0;
+    for (j = -40; j <= 40; j++) {
+	jd.date1 = J2000_EPOCH + j * 36524.9;
+	jd.date2 = 0;
+	elp82b_coordinates(&jd, &ref);
+	elp82b_coordinates_fast(&jd, 1, &moon);
+	diff = fmax(diff, fabs(moon.x - ref.x));
+	diff = fmax(diff, fabs(moon.y - ref.y));
+	diff = fmax(diff, fabs(moon.z - ref.z));
+    }
+    printf("%10s: %8.2e KM %s (tolerance %g KM)\n", "Moon", diff,
+	   diff <= ELP82B_FAST_TOLERANCE ? "OK" : "FAILED",
+	   ELP82B_FAST_TOLERANCE);
+
+    printf("\nLargest difference between elp82b_coordinates_batch in both"
+	   " frames and\nelp82b_coordinates from -2000 to 6000 (tolerance"
+	   " %g KM)\n\n", ELP82B_BATCH_TOLERANCE);
+    for (j = 0; j < VSOP87_BLOCK_SIZE; j++) {
+	epochs[j].date1 = J2000_EPOCH + (j - 32) * 45656.1;
+	epochs[j].date2 = 0.375;
+    }
+    for (k = VSOP87_KERNEL_SCALAR; k <= VSOP87_KERNEL_REPRODUCIBLE; k++) {
+	if (elp82b_set_kernel(k) != SUCCESS) {
+	    printf("%10s: not supported\n", kernel_names[k]);
+	    continue;
+	}
+
+	diff = 0;
+	for (i = ELP82B_FRAME_ECLIPTIC; i <= ELP82B_FRAME_EQUATORIAL; i++) {
+	    elp82b_coordinates_batch(epochs, VSOP87_BLOCK_SIZE, i, batch);
+	    for (j = 0; j < VSOP87_BLOCK_SIZE; j++) {
+		elp82b_coordinates(&epochs[j], &ref);
+		if (i == ELP82B_FRAME_EQUATORIAL)
+		    elp82b_ecliptic_to_equator(&ref);
+		diff = fmax(diff, fabs(batch[j].x - ref.x));
+		diff = fmax(diff, fabs(batch[j].y - ref.y));
+		diff = fmax(diff, fabs(batch[j].z - ref.z));
+	    }
+	}
+
+	printf("%10s: %8.2e KM %s\n", kernel_names[k], diff,
+	       diff <= ELP82B_BATCH_TOLERANCE ? "OK" : "FAILED");
+    }
+    elp82b_set_kernel(kernel);
+
+    /*
+     * With the reproducible kernels, a position must not depend on how many
+     * epochs are calculated together or on the routine used.
+     */
+    diff = 0;
+    for (j = 0; j < VSOP87_BLOCK_SIZE; j++) {
+	epochs[j].date1 = J2000_EPOCH + j * 365.25;
+	epochs[j].date2 = 0.125;
+    }
+    if (vsop87_set_kernel(VSOP87_KERNEL_REPRODUCIBLE) == SUCCESS &&
+	elp82b_set_kernel(VSOP87_KERNEL_REPRODUCIBLE) == SUCCESS) {
+	for (i = MERCURY; i <= NEPTUNE; i++) {
+	    vsop87_coordinates_batch(i, epochs, VSOP87_BLOCK_SIZE, batch);
+	    for (j = 0; j < VSOP87_BLOCK_SIZE; j++) {
+		vsop87_coordinates(i, &epochs[j], &moon);
+		vsop87_state(i, &epochs[j], &ref, &vel);
+		diff += (moon.x != batch[j].x) + (moon.y != batch[j].y) +
+		    (moon.z != batch[j].z) + (ref.x != moon.x) +
+		    (ref.y != moon.y) + (ref.z != moon.z);
+	    }
+
+	    vsop87_coordinates_fast(i, epochs, VSOP87_BLOCK_SIZE, batch);
+	    for (j = 0; j < VSOP87_BLOCK_SIZE; j++) {
+		vsop87_coordinates_fast(i, &epochs[j], 1, &moon);
+		diff += (moon.x != batch[j].x) + (moon.y != batch[j].y) +
+		    (moon.z != batch[j].z);
+	    }
+	}
+
+	elp82b_coordinates_fast(epochs, VSOP87_BLOCK_SIZE, batch);
+	for (j = 0; j < VSOP87_BLOCK_SIZE; j++) {
+	    elp82b_coordinates_fast(&epochs[j], 1, &moon);
+	    diff += (moon.x != batch[j].x) + (moon.y != batch[j].y) +
+		(moon.z != batch[j].z);
+	}
+
+	/* The bits of a position must also be the same on every machine */
+	vsop87_coordinates(EARTH, &epochs[0], &moon);
+	printf("\nReproducible kernels, the same for any number of epochs:"
+	       " %s\nEarth on 2000-01-01 15:00:00 TDB: x = %a AU %s\n",
+	       diff == 0 ? "OK" : "FAILED", moon.x,
+	       moon.x == -0x1.6f2d7deb0c2ecp-3 ? "OK" : "FAILED");
+    } else {
+	printf("\nReproducible kernels: not supported\n");
+    }
+    vsop87_set_kernel(kernel);
+    elp82b_set_kernel(kernel);
+
+    jd.date1 = 2455200.50;
+    jd.date2 = 0;
     elp82b_coordinates(&jd, &moon);
     elp82b_ecliptic_to_equator(&moon);
     printf("\nGeocentric rectangular coordinates for "
@@ -0,0 +1,153 @@
+/*
+ * moon_latency.c - Latency of single ELP82B positions with & without threads
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <kepler.h>
+#include <elp82b.h>
+
+/* Calls timed when none are given on the command line */
+#define DEFAULT_CALLS	2000
+
+/* Percentiles of the latency that are reported */
+static double percentiles[] = {50, 90, 99, 99.9};
+
+void display_usage()
+{
+    printf("Usage: moon_latency [THREADS] [CALLS]\n");
+    printf("Time CALLS single calls of elp82b_coordinates() with one thread"
+	   " and with a\nworker pool of THREADS threads, and report the"
+	   " percentiles of their latency.\nTHREADS defaults to the number of"
+	   " CPUs, CALLS to %d.\n\n", DEFAULT_CALLS);
+    printf("  -h, --help    display this help screen and exit\n");
+    printf("  -v, --version display version number and exit\n");
+}
+
+void parse_command_line(int argc, char *argv[], int *threads, int *calls)
+{
+    *threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (*threads > ELP82B_MAX_THREADS)
+	*threads = ELP82B_MAX_THREADS;
+    if (*threads < 2)
+	*threads = 2;
+    *calls = DEFAULT_CALLS;
+
+    if (argc > 1) {
+	if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+	    display_usage();
+	    exit(0);
+	}
+
+	if (!strcmp(argv[1], "-v") || !strcmp(argv[1], "--version")) {
+	    printf(PROG_VERSION_STRING);
+	    printf(PROG_COPYRIGHT);
+	    exit(0);
+	}
+
+	*threads = atoi(argv[1]);
+    }
+
+    if (argc > 2)
+	*calls = atoi(argv[2]);
+
+    if (argc > 3 || *threads < 1 || *threads > ELP82B_MAX_THREADS ||
+	*calls < 1) {
+	display_usage();
+	exit(1);
+    }
+}
+
+/* Orders latencies for qsort() */
+int compare_latency(const void *x, const void *y)
+{
+    double a = *(const double *)x;
+    double b = *(const double *)y;
+
+    return (a > b) - (a < b);
+}
+
+/*
+ * Times single calls of elp82b_coordinates() a day apart, and prints the
+ * percentiles of their latency in microseconds.
+ */
+void time_calls(const char *label, int calls, double *latency)
+{
+    int i,k;
+    struct julian_date jd;
+    struct rectangular_coordinates pos;
+    struct timespec t0,t1;
+
+    for (i = 0; i < calls; i++) {
+	jd.date1 = J2000_EPOCH + i;
+	jd.date2 = 0.5;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	elp82b_coordinates(&jd, &pos);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	latency[i] = (t1.tv_sec - t0.tv_sec) * 1E6 +
+	    (t1.tv_nsec - t0.tv_nsec) * 1E-3;
+    }
+
+    qsort(latency, calls, sizeof(double), compare_latency);
+    printf("%-12s", label);
+    for (k = 0; k < sizeof(percentiles) / sizeof(percentiles[0]); k++)
+	printf(" %9.1f", latency[(int)(percentiles[k] / 100 * (calls - 1))]);
+    printf(" %9.1f\n", latency[calls - 1]);
+}
+
+int main(int argc, char *argv[])
+{
+    int k,threads,calls;
+    double *latency;
+    char label[32];
+    struct julian_date jd = {J2000_EPOCH, 0};
+    struct rectangular_coordinates pos;
+
+    parse_command_line(argc, argv, &threads, &calls);
+
+    latency = malloc(calls * sizeof(double));
+    if (!latency) {
+	printf("Out of memory\n");
+	return 1;
+    }
+
+    /* The first call builds the packed form of the theory */
+    elp82b_coordinates(&jd, &pos);
+
+    printf("Latency of elp82b_coordinates() in microseconds over %d calls"
+	   "\n\n%-12s", calls, "");
+    for (k = 0; k < sizeof(percentiles) / sizeof(percentiles[0]); k++)
+	printf("   p%-6g", percentiles[k]);
+    printf("       max\n");
+
+    time_calls("1 thread", calls, latency);
+
+    if (elp82b_set_threads(threads) != SUCCESS) {
+	printf("\nCould not start %d threads\n", threads);
+	free(latency);
+	return 1;
+    }
+    sprintf(label, "%d threads", threads);
+    time_calls(label, calls, latency);
+    elp82b_set_threads(0);
+
+    free(latency);
+    return 0;
+}
@@ -37,6 +37,7 @@ int main(int argc, char *argv[])
     int i,j,year,month,day,steps;
     struct julian_date jd0,jd;
     struct equatorial_coordinates equ;
+    struct vsop87_snapshot snap[24/TIME_STEP+1];
     double longitude,latitude,h0,gast,del_t,del_cor,df[24/TIME_STEP+1],
 	rad[24/TIME_STEP+1],decd[24/TIME_STEP+1],rts[3],dist,
 	prec[3][3],w;
@@ -70,6 +71,13 @@ int main(int argc, char *argv[])
     longitude *= DEG_TO_RAD;
     latitude *= DEG_TO_RAD;
     steps = sizeof(df)/sizeof(double);
+
+    /* The Earth and the planets are needed for every body at every step */
+    for (j = 0; j < steps; j++) {
+	jd.date2 = jd0.date2 + (double)j*TIME_STEP/24;
+	vsop87_snapshot(&jd, VSOP87_ALL_PLANETS, 0, &snap[j]);
+    }
+
     for (i = SUN; i <= PLUTO; i++) {
 	if (i == EARTH)
 	    continue;
@@ -78,7 +86,7 @@ int main(int argc, char *argv[])
 	for (j = steps-1; j >= 0; j--) {
 	    df[j] = (double)j*TIME_STEP/24;
 	    jd.date2 = jd0.date2 + df[j];
-	    get_equatorial(i, &jd, &equ, prec, &dist);
+	    get_equatorial(i, &jd, &snap[j], &equ, prec, &dist);
 	    rad[j] = equ.right_ascension;
 	    decd[j] = equ.declination;
 	}
@@ -118,15 +126,16 @@ int main(int argc, char *argv[])
 }
 
 void get_equatorial(int body, struct julian_date *jd,
+		    struct vsop87_snapshot *snap,
 		    struct equatorial_coordinates *equ,
 		    double prec[3][3], double *dist)    
 {
     struct rectangular_coordinates ear,rec,sun = {0,0,0};
 
-    vsop87_coordinates(EARTH, jd, &ear);
+    ear = snap->pos[EARTH];
     if (body >= MERCURY && body <= NEPTUNE) {
 	/* Use VSOP87 for all eight major planets */
-	vsop87_coordinates(body, jd, &rec);
+	rec = snap->pos[body];
 
 	/* Correct for finite speed of light */
 	lightcor(body, jd, &rec, &ear);
@@ -22,6 +22,7 @@
 #include <kepler.h>
 #include <julian_date.h>
 #include <coordinates.h>
+#include <vsop87.h>
 
 enum {
     SUN = -2,
@@ -36,6 +37,7 @@ enum {
 #define PLANET_REFRACTION	(-2040 * ACS_TO_RAD) /* -34 arc minutes */
 
 void get_equatorial(int body, struct julian_date *jd,
+		    struct vsop87_snapshot *snap,
 		    struct equatorial_coordinates *equ,
 		    double prec[3][3], double *dist);
 
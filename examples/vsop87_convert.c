@@ -0,0 +1,246 @@
+/*
+ * vsop87_convert.c - Convert the VSOP87 ASCII files to binary tables
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <kepler.h>
+#include <vsop87.h>
+
+/* Names of the bodies in the header lines of the original files */
+static char *body_names[] = {"MERCURY","VENUS","EARTH","MARS","JUPITER",
+			     "SATURN","URANUS","NEPTUNE","EMB","SUN"};
+
+/* Amplitudes, phases & frequencies of every series of every body */
+static double *terms[VSOP87_BODY_COUNT][VSOP87_SERIES_PER_BODY][3];
+
+void display_usage()
+{
+    printf("Usage: vsop87_convert OUTPUT INPUT...\n");
+    printf("Convert the original files of a version of the VSOP87 theory\n"
+	   "(e.g. VSOP87E.ear VSOP87E.sun ...) to a binary table for"
+	   " vsop87_load()\n\n");
+    printf("  -h, --help    display this help screen and exit\n");
+    printf("  -v, --version display version number and exit\n");
+}
+
+void parse_command_line(int argc, char *argv[])
+{
+    if (argc > 1) {
+	if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
+	    display_usage();
+	    exit(0);
+	}
+
+	if (!strcmp(argv[1], "-v") || !strcmp(argv[1], "--version")) {
+	    printf(PROG_VERSION_STRING);
+	    printf(PROG_COPYRIGHT);
+	    exit(0);
+	}
+    }
+
+    if (argc < 3) {
+	display_usage();
+	exit(1);
+    }
+}
+
+/*
+ * Reads the series in one of the original files of the theory. Each series
+ * starts with a header line in the Fortran format
+ * (17x,i1,4x,a7,12x,i1,17x,i1,i7) giving the version, body, variable, power
+ * of t and number of terms. The amplitude, phase and frequency of each term
+ * are in columns 80-97, 98-111 & 112-131 of the lines that follow.
+ *
+ * path -- The file to be read.
+ * header -- The file header, updated with the series read.
+ *
+ * Return: SUCCESS -- If the file has been read successfully.
+ *         ERR_FILE_ACCESS -- If the file could not be opened.
+ *         ERR_INVALID_DATA -- If the file is not in the expected format or
+ *                             has no series.
+ */
+int read_file(char *path, struct vsop87_file_header *header)
+{
+    FILE *fp;
+    char line[256],name[8];
+    int i,j,body,series,count,version,found;
+
+    fp = fopen(path, "r");
+    if (!fp)
+	return ERR_FILE_ACCESS;
+
+    found = 0;
+    while (fgets(line, sizeof(line), fp)) {
+	if (strncmp(line + 1, "VSOP87", 6) || strlen(line) < 67)
+	    continue;
+
+	/* Versions 1 to 5 are A to E; version 0 is not supported */
+	version = line[17] - '1' + 'A';
+	if (version < 'A' || version > 'E' ||
+	    (header->version && header->version != version))
+	    break;
+	header->version = version;
+
+	sscanf(line + 22, "%7s", name);
+	for (body = 0; body < VSOP87_BODY_COUNT; body++) {
+	    if (!strcmp(name, body_names[body]))
+		break;
+	}
+	if (!strcmp(name, "EARTH-M"))
+	    body = VSOP87_EMB;
+
+	series = (line[41] - '1') * 6 + line[59] - '0';
+	count = atoi(line + 60);
+	if (body == VSOP87_BODY_COUNT || series < 0 ||
+	    series >= VSOP87_SERIES_PER_BODY || count <= 0 ||
+	    terms[body][series][0])
+	    break;
+
+	for (j = 0; j < 3; j++) {
+	    terms[body][series][j] = calloc(count, sizeof(double));
+	    if (!terms[body][series][j])
+		break;
+	}
+	if (j < 3)
+	    break;
+
+	for (i = 0; i < count; i++) {
+	    if (!fgets(line, sizeof(line), fp) || strlen(line) < 131)
+		break;
+
+	    line[131] = '\0';
+	    terms[body][series][2][i] = atof(line + 111);
+	    line[111] = '\0';
+	    terms[body][series][1][i] = atof(line + 97);
+	    line[97] = '\0';
+	    terms[body][series][0][i] = atof(line + 79);
+	}
+	if (i < count)
+	    break;
+
+	header->bodies |= 1 << body;
+	header->series[body][series].count = count;
+	found++;
+    }
+
+    i = feof(fp);
+    fclose(fp);
+
+    return (i && found) ? SUCCESS : ERR_INVALID_DATA;
+}
+
+/*
+ * Writes the binary table. The coefficient arrays of each series follow the
+ * header, aligned & padded as described in vsop87.h.
+ *
+ * path -- The file to be written.
+ * header -- The file header with the number of terms in each series.
+ *
+ * Return: SUCCESS -- If the file has been written successfully.
+ *         ERR_FILE_ACCESS -- If the file could not be written.
+ */
+int write_file(char *path, struct vsop87_file_header *header)
+{
+    FILE *fp;
+    int i,j,k,n;
+    int64_t offset;
+    struct vsop87_file_series *fs;
+    static const double zeros[VSOP87_TERM_ALIGNMENT] = {0};
+
+    memcpy(header->magic, VSOP87_FILE_MAGIC, sizeof(VSOP87_FILE_MAGIC));
+    header->format = VSOP87_FILE_FORMAT;
+    header->byte_order = VSOP87_FILE_BYTE_ORDER;
+
+    /* Lay out the arrays of every series after the header */
+    offset = sizeof(*header);
+    for (i = 0; i < VSOP87_BODY_COUNT; i++) {
+	for (j = 0; j < VSOP87_SERIES_PER_BODY; j++) {
+	    fs = &header->series[i][j];
+	    if (!fs->count)
+		continue;
+
+	    fs->padded = (fs->count + VSOP87_TERM_PADDING - 1) /
+		VSOP87_TERM_PADDING * VSOP87_TERM_PADDING;
+	    offset = (offset + VSOP87_TERM_ALIGNMENT - 1) /
+		VSOP87_TERM_ALIGNMENT * VSOP87_TERM_ALIGNMENT;
+	    fs->offset = offset;
+	    offset += 3 * fs->padded * sizeof(double);
+	}
+    }
+
+    fp = fopen(path, "wb");
+    if (!fp)
+	return ERR_FILE_ACCESS;
+
+    fwrite(header, sizeof(*header), 1, fp);
+    offset = sizeof(*header);
+    for (i = 0; i < VSOP87_BODY_COUNT; i++) {
+	for (j = 0; j < VSOP87_SERIES_PER_BODY; j++) {
+	    fs = &header->series[i][j];
+	    if (!fs->count)
+		continue;
+
+	    fwrite(zeros, 1, fs->offset - offset, fp);
+	    for (k = 0; k < 3; k++) {
+		fwrite(terms[i][j][k], sizeof(double), fs->count, fp);
+		n = fs->padded - fs->count;
+		fwrite(zeros, sizeof(double), n, fp);
+	    }
+	    offset = fs->offset + 3 * fs->padded * sizeof(double);
+	}
+    }
+
+    i = ferror(fp);
+    if (fclose(fp) || i)
+	return ERR_FILE_ACCESS;
+
+    return SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    int i,retval;
+    struct vsop87_file_header header;
+
+    parse_command_line(argc, argv);
+
+    memset(&header, 0, sizeof(header));
+    for (i = 2; i < argc; i++) {
+	retval = read_file(argv[i], &header);
+	if (retval != SUCCESS) {
+	    fprintf(stderr, "%s: %s\n", argv[i], retval == ERR_FILE_ACCESS ?
+		    "cannot be read" : "not a VSOP87 (version A to E) file");
+	    return(1);
+	}
+    }
+
+    if (write_file(argv[1], &header) != SUCCESS) {
+	fprintf(stderr, "%s: cannot be written\n", argv[1]);
+	return(1);
+    }
+
+    printf("VSOP87%c table with", header.version);
+    for (i = 0; i < VSOP87_BODY_COUNT; i++) {
+	if (header.bodies & (1 << i))
+	    printf(" %s", body_names[i]);
+    }
+    printf(" written to %s\n", argv[1]);
+
+    return(0);
+}
@@ -35,6 +35,8 @@ class ReturnValues:
     ERR_INVALID_ECCENTRICITY = -3
     ERR_CONVERGENCE = -4
     ERR_INVALID_DATA = -5
+    ERR_UNSUPPORTED = -6
+    ERR_FILE_ACCESS = -7
 
 class Constants:
 
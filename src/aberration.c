@@ -27,8 +27,12 @@
 #include <memory.h>
 #include <kepler.h>
 #include <fund_args.h>
+#include <harmonic.h>
 #include <aberration.h>
 
+/* Largest multiple of a fundamental argument in the series */
+#define ABERRATION_MAX_MULTIPLE	25
+
 /*
  * Terms for velocity components of the EMB's heliocentric motion #1
  */
@@ -179,24 +183,43 @@ void aberration_earth_velocity(struct julian_date *tdb,
 			struct rectangular_coordinates *vel)
 {
 	int i;
+	short m[6];
+	double t,c_phi,s_phi;
 	struct rectangular_coordinates v1,v2,v3;
-	double t,me,ve,ea,ma,ju,sa,ur,ne,l,lp,f,d,w,phi,c_phi,s_phi;
+	struct harmonic_table me,ve,ea,ma,ju,sa,ur,ne,l,lp,f,d,w;
+	const struct harmonic_table *h1_1[1] = {&ea};
+	const struct harmonic_table *h1_2[6] = {&me, &ve, &ea, &ma, &ju, &sa};
+	const struct harmonic_table *h2[6] = {&ve, &ea, &ju, &sa, &ur, &ne};
+	const struct harmonic_table *h3[5] = {&w, &d, &lp, &l, &f};
 
-	/* Fundamental arguments */
+	/* Multiples of the fundamental arguments */
 	t  = JULIAN_CENTURIES(tdb->date1, tdb->date2);
-	me = fundamental_argument(ARG_LONGITUDE_MERCURY, t);
-	ve = fundamental_argument(ARG_LONGITUDE_VENUS, t);
-	ea = fundamental_argument(ARG_LONGITUDE_EARTH, t);
-	ma = fundamental_argument(ARG_LONGITUDE_MARS, t);
-	ju = fundamental_argument(ARG_LONGITUDE_JUPITER, t);
-	sa = fundamental_argument(ARG_LONGITUDE_SATURN, t);
-	ur = fundamental_argument(ARG_LONGITUDE_URANUS, t);
-	ne = fundamental_argument(ARG_LONGITUDE_NEPTUNE, t);
-	l  = fundamental_argument(ARG_ANOMALY_MOON, t);
-	lp = fundamental_argument(ARG_ANOMALY_SUN, t);
-	f  = fundamental_argument(ARG_LATITUDE_MOON, t);
-	d  = fundamental_argument(ARG_ELONGATION_MOON, t);
-	w  = fundamental_argument(ARG_LONGITUDE_MOON, t);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_MERCURY, t),
+		ABERRATION_MAX_MULTIPLE, &me);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_VENUS, t),
+		ABERRATION_MAX_MULTIPLE, &ve);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_EARTH, t),
+		ABERRATION_MAX_MULTIPLE, &ea);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_MARS, t),
+		ABERRATION_MAX_MULTIPLE, &ma);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_JUPITER, t),
+		ABERRATION_MAX_MULTIPLE, &ju);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_SATURN, t),
+		ABERRATION_MAX_MULTIPLE, &sa);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_URANUS, t),
+		ABERRATION_MAX_MULTIPLE, &ur);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_NEPTUNE, t),
+		ABERRATION_MAX_MULTIPLE, &ne);
+	harmonic_table(fundamental_argument(ARG_ANOMALY_MOON, t),
+		ABERRATION_MAX_MULTIPLE, &l);
+	harmonic_table(fundamental_argument(ARG_ANOMALY_SUN, t),
+		ABERRATION_MAX_MULTIPLE, &lp);
+	harmonic_table(fundamental_argument(ARG_LATITUDE_MOON, t),
+		ABERRATION_MAX_MULTIPLE, &f);
+	harmonic_table(fundamental_argument(ARG_ELONGATION_MOON, t),
+		ABERRATION_MAX_MULTIPLE, &d);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_MOON, t),
+		ABERRATION_MAX_MULTIPLE, &w);
 
 	memset(&v1, 0, sizeof(v1));
 	memset(&v2, 0, sizeof(v2));
@@ -210,14 +233,13 @@ void aberration_earth_velocity(struct julian_date *tdb,
 	/* EMB's heliocentric motion #2 */
 	i = sizeof(aberration_series1_2) / sizeof(aberration_series1_2[0]) - 1;
 	for (; i >= 0; i--) {
-		phi = aberration_series1_2[i].l_me * me +
-			aberration_series1_2[i].l_ve * ve +
-			aberration_series1_2[i].l_ea * ea +
-			aberration_series1_2[i].l_ma * ma +
-			aberration_series1_2[i].l_ju * ju +
-			aberration_series1_2[i].l_sa * sa;
-
-		sincos(phi, &s_phi, &c_phi);
+		m[0] = aberration_series1_2[i].l_me;
+		m[1] = aberration_series1_2[i].l_ve;
+		m[2] = aberration_series1_2[i].l_ea;
+		m[3] = aberration_series1_2[i].l_ma;
+		m[4] = aberration_series1_2[i].l_ju;
+		m[5] = aberration_series1_2[i].l_sa;
+		harmonic_sincos(m, h1_2, 6, &s_phi, &c_phi);
 
 		v1.x += aberration_series1_2[i].x_sin * s_phi +
 			aberration_series1_2[i].x_cos * c_phi;
@@ -230,9 +252,8 @@ void aberration_earth_velocity(struct julian_date *tdb,
 	/* EMB's heliocentric motion #1 */
 	i = sizeof(aberration_series1_1) / sizeof(aberration_series1_1[0]) - 1;
 	for (; i >= 0; i--) {
-		phi = aberration_series1_1[i].l_ea * ea;
-
-		sincos(phi, &s_phi, &c_phi);
+		harmonic_sincos(&aberration_series1_1[i].l_ea, h1_1, 1,
+				&s_phi, &c_phi);
 
 		v1.x += (aberration_series1_1[i].x_sin +
 			aberration_series1_1[i].x_sin_t * t) * s_phi;
@@ -256,14 +277,13 @@ void aberration_earth_velocity(struct julian_date *tdb,
 	/* The Sun's motion wrt the solar system barycenter */
 	i = sizeof(aberration_series2) / sizeof(aberration_series2[0]) - 1;
 	for (; i >= 0; i--) {
-		phi = aberration_series2[i].l_ve * ve +
-			aberration_series2[i].l_ea * ea +
-			aberration_series2[i].l_ju * ju +
-			aberration_series2[i].l_sa * sa +
-			aberration_series2[i].l_ur * ur +
-			aberration_series2[i].l_ne * ne;
-
-		sincos(phi, &s_phi, &c_phi);
+		m[0] = aberration_series2[i].l_ve;
+		m[1] = aberration_series2[i].l_ea;
+		m[2] = aberration_series2[i].l_ju;
+		m[3] = aberration_series2[i].l_sa;
+		m[4] = aberration_series2[i].l_ur;
+		m[5] = aberration_series2[i].l_ne;
+		harmonic_sincos(m, h2, 6, &s_phi, &c_phi);
 
 		v2.x += aberration_series2[i].x_sin * s_phi +
 			aberration_series2[i].x_cos * c_phi;
@@ -276,13 +296,12 @@ void aberration_earth_velocity(struct julian_date *tdb,
 	/* The Earth's motion wrt to the EMB */
 	i = sizeof(aberration_series3) / sizeof(aberration_series3[0]) - 1;
 	for (; i >= 0; i--) {
-		phi = aberration_series3[i].w * w +
-			aberration_series3[i].d * d +
-			aberration_series3[i].lp * lp +
-			aberration_series3[i].l * l +
-			aberration_series3[i].f * f;
-
-		sincos(phi, &s_phi, &c_phi);
+		m[0] = aberration_series3[i].w;
+		m[1] = aberration_series3[i].d;
+		m[2] = aberration_series3[i].lp;
+		m[3] = aberration_series3[i].l;
+		m[4] = aberration_series3[i].f;
+		harmonic_sincos(m, h3, 5, &s_phi, &c_phi);
 
 		v3.x += aberration_series3[i].x_sin * s_phi;
 		v3.y += aberration_series3[i].y_cos * c_phi;
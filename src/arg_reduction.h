@@ -0,0 +1,121 @@
+/*
+ * arg_reduction.h - Reduction of the arguments of the analytic theories
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The arguments c*t of the theories grow to 1.6E6 radians for Mercury in
+ * VSOP87 and 3E5 radians for the Moon in ELP 2000-82B, 4000 years from
+ * J2000. Rounding t and c*t to doubles then costs up to 1E-10 radians, and
+ * sin() & cos() have to reduce such arguments themselves.
+ *
+ * Instead, every rate c is kept in radians per day as hi + lo, where hi has
+ * at most 30 significant bits, and every epoch as a whole number of days
+ * from J2000 plus a fraction. Within 2^23 days (about 23000 years) of J2000,
+ * hi times the whole days is exact and is reduced by 2*PI exactly with a
+ * three part Cody-Waite reduction. The rest of c*t is small, so the reduced
+ * argument is accurate to a few units in 1E-16 radians, and always lies
+ * within PI + |c| of 0.
+ *
+ * This is an internal header, included by the theories that use it.
+ */
+
+#ifndef _ARG_REDUCTION_H_
+#define _ARG_REDUCTION_H_
+
+#include <math.h>
+#include <julian_date.h>
+
+/* 2*PI split into two parts of 32 bits each and a third of 53 bits */
+#define REDUCTION_2PI_1		6.28318530693650245667E+00
+#define REDUCTION_2PI_2		2.43084020252158639064E-10
+#define REDUCTION_2PI_3		8.08906499518380252616E-21
+#define REDUCTION_1_OVER_2PI	0.159154943091895335769
+
+/* Keeps reduce_argument() the same whether or not a*b + c can be fused */
+#ifdef __GNUC__
+#define REDUCTION_ATTR	__attribute__((optimize("fp-contract=off")))
+#else
+#define REDUCTION_ATTR
+#endif
+
+/*
+ * Converts a rate to radians per day in the form used by reduce_argument().
+ * c*scale/days is calculated in double-double arithmetic, and split after
+ * its leading 30 bits with Veltkamp's method.
+ *
+ * c -- The rate.
+ * scale -- The number of radians in the angular unit of c.
+ * days -- The number of days in the time unit of c.
+ * hi -- The leading 30 bits of the rate in radians per day.
+ * lo -- The rest of the rate.
+ */
+static __inline__ void reduction_rate(double c, double scale, double days,
+		double *hi, double *lo)
+{
+	double p,q,r,s,v;
+
+	p = c * scale;
+	q = fma(c, scale, -p);
+	r = p / days;
+	s = (fma(-r, days, p) + q) / days;
+
+	/* 2^23 + 1 keeps 53 - 23 bits */
+	v = r * 8388609.0;
+	*hi = v - (v - r);
+	*lo = (r - *hi) + s;
+}
+
+/*
+ * Splits an epoch into a whole number of days from J2000 and a fraction of
+ * a day. Both are exact as long as date1 is within a factor of 2 of
+ * J2000_EPOCH, as it is for the usual splits of a julian_date.
+ *
+ * jd -- The epoch.
+ * whole -- The whole number of days from J2000.
+ * frac -- The rest, between -0.5 & 0.5 days.
+ */
+static __inline__ void reduction_days(const struct julian_date *jd,
+		double *whole, double *frac)
+{
+	double d;
+
+	d = jd->date1 - J2000_EPOCH;
+	*whole = floor(d + jd->date2 + 0.5);
+	*frac = (d - *whole) + jd->date2;
+}
+
+/*
+ * Calculates c*t modulo 2*PI.
+ *
+ * hi, lo -- The rate c from reduction_rate().
+ * whole, frac -- The epoch t from reduction_days().
+ *
+ * Return: The reduced argument in radians.
+ */
+static __inline__ REDUCTION_ATTR double reduce_argument(double hi,
+		double lo, double whole, double frac)
+{
+	double x,k;
+
+	x = hi * whole;
+	k = floor(x * REDUCTION_1_OVER_2PI + 0.5);
+
+	return ((x - k * REDUCTION_2PI_1) - k * REDUCTION_2PI_2) -
+		k * REDUCTION_2PI_3 + (lo * whole + (hi + lo) * frac);
+}
+
+#endif
@@ -0,0 +1,579 @@
+/*
+ * chebyshev.c - Routines to read & fit Chebyshev ephemerides
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A Chebyshev ephemeris holds piecewise polynomial fits to the analytic
+ * theories in this library, in the manner of the JPL ephemerides. Looking
+ * up a position costs a few dozen multiplications instead of the thousands
+ * of sines & cosines needed by the theories themselves. The files are
+ * created by examples/chebyshev_fit and mapped read-only into memory, so
+ * that every process that opens one shares a single copy of its pages.
+ *
+ * Without a file, chebyshev_moon() fits segments for the Moon as they are
+ * needed, and keeps the most recently used ones in memory.
+ */
+
+#include <math.h>
+#include <memory.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <chebyshev.h>
+#include <elp82b.h>
+
+/*
+ * Segments of the Moon cache are fitted through this many Chebyshev nodes,
+ * which leaves the fit at the level of the rounding errors of ELP 2000-82B
+ * over CHEBYSHEV_MOON_SEGMENT days. The series is then cut to the fewest
+ * coefficients whose dropped tail is within the error bound of the cache.
+ */
+#define MOON_NODES	24
+
+/* A segment of the Moon cache, calculated by fit_moon_segment() */
+struct moon_segment {
+	long index;		/* Segment number, counted from J2000 */
+	int n;			/* Coefficients kept in each row */
+	int next;		/* Next segment in the same bucket, or -1 */
+	unsigned long used;	/* Clock of the last lookup */
+	double c[3][MOON_NODES];
+};
+
+/*
+ * The Moon cache is shared by every thread of the process. Lookups hold
+ * moon_lock for reading, and only stamp the segment they find with the
+ * clock, so that warm queries from many threads do not wait on each other.
+ * Segments are fitted outside the lock, and added with it held for writing,
+ * replacing the least recently used segment once the cache is full.
+ */
+static struct moon_cache {
+	unsigned int size;	/* Largest number of segments */
+	unsigned int count;	/* Segments in use */
+	unsigned int mask;	/* Number of buckets - 1 */
+	unsigned int generation;  /* Bumped when the cache is set up again */
+	double error;		/* Error bound of the fits in KM */
+	int *bucket;		/* First segment in each bucket, or -1 */
+	struct moon_segment *segment;
+	unsigned long clock;	/* Number of lookups */
+	unsigned long misses;	/* Number of segments fitted */
+} moon_cache = {CHEBYSHEV_MOON_CACHE_SIZE, 0, 0, 1, CHEBYSHEV_MOON_ERROR};
+
+static pthread_rwlock_t moon_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*
+ * Each thread also keeps a copy of the segment it used last, which answers
+ * queries without taking the lock while the thread stays in that segment.
+ * Its hits are added to the clock when the thread moves on.
+ */
+static __thread struct moon_hint {
+	unsigned int generation;  /* Generation of the copy, 0 if none */
+	unsigned long hits;	/* Hits not yet added to the clock */
+	struct moon_segment segment;
+} moon_hint;
+
+/*
+ * Checks that the segments of a body in a file lie within the file.
+ *
+ * fb -- The body in the file header.
+ * size -- The size of the file.
+ *
+ * Return: 1 -- If the body is valid.
+ *         0 -- If it is not.
+ */
+static int valid_file_body(const struct chebyshev_file_body *fb, size_t size)
+{
+	return fb->degree >= 0 && fb->degree <= CHEBYSHEV_MAX_DEGREE &&
+		fb->segments > 0 && fb->length > 0 &&
+		fb->offset >= (int64_t)sizeof(struct chebyshev_file_header) &&
+		fb->offset % CHEBYSHEV_FILE_ALIGNMENT == 0 &&
+		(uint64_t)fb->offset + (uint64_t)fb->segments * 3 *
+			(fb->degree + 1) * sizeof(double) <= size;
+}
+
+/*
+ * Evaluates the polynomials of a segment, and optionally their derivative.
+ *
+ * c -- The coefficients of x, y & z, one row each.
+ * stride -- The number of doubles from one row to the next.
+ * n -- The number of coefficients used in each row, the degree + 1.
+ * tau -- The epoch scaled to [-1, 1] over the segment.
+ * length -- The length of the segment in days.
+ * pos -- The coordinates.
+ * vel -- If not NULL, the velocity per day.
+ */
+static void evaluate(const double *c, int stride, int n, double tau,
+		double length, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	int i,k;
+	double t0,t1,t2,u0,u1,u2,p[3],d[3];
+
+	/*
+	 * T(i) is built up with T(i+1) = 2*tau*T(i) - T(i-1), and the
+	 * derivative dT(i)/dtau = i*U(i-1) with the same recurrence for U,
+	 * starting from U(-1) = 0 and U(0) = 1.
+	 */
+	for (i = 0; i < 3; i++) {
+		p[i] = c[i * stride];
+		d[i] = 0;
+	}
+
+	t0 = 1;
+	t1 = tau;
+	u0 = 0;
+	u1 = 1;
+	for (k = 1; k < n; k++) {
+		for (i = 0; i < 3; i++) {
+			p[i] += c[i * stride + k] * t1;
+			d[i] += c[i * stride + k] * k * u1;
+		}
+
+		t2 = 2 * tau * t1 - t0;
+		u2 = 2 * tau * u1 - u0;
+		t0 = t1;
+		t1 = t2;
+		u0 = u1;
+		u1 = u2;
+	}
+
+	pos->x = p[0];
+	pos->y = p[1];
+	pos->z = p[2];
+	if (vel) {
+		vel->x = d[0] * 2 / length;
+		vel->y = d[1] * 2 / length;
+		vel->z = d[2] * 2 / length;
+	}
+}
+
+/*
+ * Maps a Chebyshev ephemeris file into memory.
+ *
+ * path -- The ephemeris file, created by examples/chebyshev_fit.
+ * eph -- The opened ephemeris. Must be released with chebyshev_close().
+ *
+ * Return: SUCCESS -- If the ephemeris has been opened.
+ *         ERR_FILE_ACCESS -- If the file could not be opened or mapped.
+ *         ERR_INVALID_DATA -- If the file is not a Chebyshev ephemeris in
+ *                             the format of this library.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated or the
+ *                            platform cannot map files.
+ */
+int chebyshev_open(const char *path, struct chebyshev_ephemeris **eph)
+{
+#ifndef _WIN32
+	int i,fd;
+	struct stat st;
+	struct chebyshev_ephemeris *e;
+	const struct chebyshev_file_header *hdr;
+	void *map;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return ERR_FILE_ACCESS;
+
+	if (fstat(fd, &st)) {
+		close(fd);
+		return ERR_FILE_ACCESS;
+	}
+	if (st.st_size < (off_t)sizeof(*hdr)) {
+		close(fd);
+		return ERR_INVALID_DATA;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return ERR_FILE_ACCESS;
+
+	hdr = map;
+	if (memcmp(hdr->magic, CHEBYSHEV_FILE_MAGIC,
+			sizeof(CHEBYSHEV_FILE_MAGIC)) ||
+		hdr->format != CHEBYSHEV_FILE_FORMAT ||
+		hdr->byte_order != CHEBYSHEV_FILE_BYTE_ORDER ||
+		(hdr->bodies & ~((1 << CHEBYSHEV_BODY_COUNT) - 1))) {
+		munmap(map, st.st_size);
+		return ERR_INVALID_DATA;
+	}
+
+	for (i = 0; i < CHEBYSHEV_BODY_COUNT; i++) {
+		if ((hdr->bodies & (1 << i)) &&
+			!valid_file_body(&hdr->body[i], st.st_size)) {
+			munmap(map, st.st_size);
+			return ERR_INVALID_DATA;
+		}
+	}
+
+	e = malloc(sizeof(*e));
+	if (!e) {
+		munmap(map, st.st_size);
+		return ERR_UNSUPPORTED;
+	}
+
+	e->bodies = hdr->bodies;
+	e->header = hdr;
+	e->size = st.st_size;
+
+	*eph = e;
+	return SUCCESS;
+#else
+	return ERR_UNSUPPORTED;
+#endif
+}
+
+/*
+ * Calculates a body's position, and optionally its velocity, from a
+ * Chebyshev ephemeris. The velocity is the derivative of the polynomials.
+ *
+ * eph -- The ephemeris from chebyshev_open().
+ * body -- A planet from enum solar_system_planets, CHEBYSHEV_PLUTO or
+ *         CHEBYSHEV_MOON.
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * pos -- The body's rectangular coordinates. See chebyshev.h for the units
+ *        & reference frame of each body.
+ * vel -- If not NULL, the body's velocity in the same units per day.
+ *
+ * Return: SUCCESS -- If the state has been calculated successfully.
+ *         ERR_INVALID_PLANET -- If the body is not present in the ephemeris.
+ *         ERR_INVALID_DATE -- If tdb is outside the time span of the body.
+ */
+int chebyshev_state(struct chebyshev_ephemeris *eph, int body,
+		struct julian_date *tdb, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	int k,n;
+	double dt,tau;
+	const double *c;
+	const struct chebyshev_file_body *fb;
+
+	if (body < 0 || body >= CHEBYSHEV_BODY_COUNT ||
+		!(eph->bodies & (1 << body)))
+		return ERR_INVALID_PLANET;
+
+	fb = &eph->header->body[body];
+	dt = (tdb->date1 - fb->start) + tdb->date2;
+	if (dt < 0 || dt > fb->segments * fb->length)
+		return ERR_INVALID_DATE;
+
+	/* The end of the time span belongs to the last segment */
+	k = (int)(dt / fb->length);
+	if (k == fb->segments)
+		k--;
+
+	n = fb->degree + 1;
+	c = (const double *)((const char *)eph->header + fb->offset) +
+		(size_t)k * 3 * n;
+	tau = 2 * (dt - k * fb->length) / fb->length - 1;
+	evaluate(c, n, n, tau, fb->length, pos, vel);
+
+	return SUCCESS;
+}
+
+/*
+ * Unmaps an ephemeris opened by chebyshev_open() and releases its memory.
+ *
+ * eph -- The ephemeris from chebyshev_open().
+ */
+void chebyshev_close(struct chebyshev_ephemeris *eph)
+{
+#ifndef _WIN32
+	munmap((void *)eph->header, eph->size);
+#endif
+	free(eph);
+}
+
+/*
+ * Fits a segment of the Moon cache to elp82b_coordinates().
+ *
+ * index -- The segment number, counted from J2000.
+ * error -- The error bound in KM.
+ * seg -- The fitted segment.
+ */
+static void fit_moon_segment(long index, double error,
+		struct moon_segment *seg)
+{
+	int i,j,k,n;
+	double x,tail[3],f[3][MOON_NODES];
+	struct julian_date t;
+	struct rectangular_coordinates p;
+
+	t.date1 = J2000_EPOCH + index * CHEBYSHEV_MOON_SEGMENT;
+	for (j = 0; j < MOON_NODES; j++) {
+		t.date2 = (cos(PI * (j + 0.5) / MOON_NODES) + 1) *
+			CHEBYSHEV_MOON_SEGMENT / 2;
+		elp82b_coordinates(&t, &p);
+		f[0][j] = p.x;
+		f[1][j] = p.y;
+		f[2][j] = p.z;
+	}
+
+	for (i = 0; i < 3; i++) {
+		for (k = 0; k < MOON_NODES; k++) {
+			x = 0;
+			for (j = 0; j < MOON_NODES; j++)
+				x += f[i][j] * cos(PI * k * (j + 0.5) /
+						MOON_NODES);
+			seg->c[i][k] = x * 2 / MOON_NODES;
+		}
+		seg->c[i][0] /= 2;
+		tail[i] = 0;
+	}
+
+	/* |T(k)| <= 1, so the dropped coefficients bound the error */
+	for (n = MOON_NODES; n > 1; n--) {
+		for (i = 0; i < 3; i++)
+			tail[i] += fabs(seg->c[i][n - 1]);
+		if (sqrt(tail[0] * tail[0] + tail[1] * tail[1] +
+				tail[2] * tail[2]) > error)
+			break;
+	}
+
+	seg->index = index;
+	seg->n = n;
+}
+
+/*
+ * Looks up a segment of the Moon cache. Must be called with moon_lock held.
+ *
+ * index -- The segment number.
+ *
+ * Return: The segment, or NULL if it is not in the cache.
+ */
+static struct moon_segment *find_moon_segment(long index)
+{
+	int i;
+
+	if (!moon_cache.bucket)
+		return NULL;
+
+	for (i = moon_cache.bucket[index & moon_cache.mask]; i >= 0;
+			i = moon_cache.segment[i].next) {
+		if (moon_cache.segment[i].index == index)
+			return &moon_cache.segment[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Allocates the segments & buckets of the Moon cache for its size. Must be
+ * called with moon_lock held for writing.
+ *
+ * Return: SUCCESS -- If the cache has been allocated.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated.
+ */
+static int alloc_moon_cache(void)
+{
+	unsigned int i,buckets;
+	int *bucket;
+	struct moon_segment *segment;
+
+	for (buckets = 1; buckets < moon_cache.size; buckets <<= 1)
+		;
+
+	bucket = malloc(buckets * sizeof(*bucket));
+	segment = malloc(moon_cache.size * sizeof(*segment));
+	if (!bucket || !segment) {
+		free(bucket);
+		free(segment);
+		return ERR_UNSUPPORTED;
+	}
+
+	for (i = 0; i < buckets; i++)
+		bucket[i] = -1;
+
+	free(moon_cache.bucket);
+	free(moon_cache.segment);
+	moon_cache.bucket = bucket;
+	moon_cache.segment = segment;
+	moon_cache.mask = buckets - 1;
+	moon_cache.count = 0;
+	return SUCCESS;
+}
+
+/*
+ * Adds a segment to the Moon cache, in place of the least recently used one
+ * if the cache is full. Must be called with moon_lock held for writing.
+ *
+ * seg -- The segment.
+ */
+static void add_moon_segment(const struct moon_segment *seg)
+{
+	unsigned int i,lru;
+	int *link;
+	struct moon_segment *s;
+
+	if (moon_cache.count < moon_cache.size) {
+		lru = moon_cache.count++;
+	} else {
+		lru = 0;
+		for (i = 1; i < moon_cache.count; i++) {
+			if (moon_cache.segment[i].used <
+				moon_cache.segment[lru].used)
+				lru = i;
+		}
+
+		link = &moon_cache.bucket[moon_cache.segment[lru].index &
+			moon_cache.mask];
+		while (*link != (int)lru)
+			link = &moon_cache.segment[*link].next;
+		*link = moon_cache.segment[lru].next;
+	}
+
+	s = &moon_cache.segment[lru];
+	*s = *seg;
+	s->used = moon_cache.clock;
+	s->next = moon_cache.bucket[seg->index & moon_cache.mask];
+	moon_cache.bucket[seg->index & moon_cache.mask] = lru;
+}
+
+/*
+ * Sets up the Moon cache used by chebyshev_moon(), and empties it. Until
+ * this is called, the cache holds CHEBYSHEV_MOON_CACHE_SIZE segments fitted
+ * within CHEBYSHEV_MOON_ERROR.
+ *
+ * segments -- The largest number of segments kept, from 1 to
+ *             CHEBYSHEV_MOON_CACHE_MAX. Each covers CHEBYSHEV_MOON_SEGMENT
+ *             days.
+ * error -- The error bound of the fits in KM. Bounds below about 1E-4 KM
+ *          are limited by the rounding errors of ELP 2000-82B and are not
+ *          met; the segments then keep all their coefficients.
+ *
+ * Return: SUCCESS -- If the cache has been set up.
+ *         ERR_UNSUPPORTED -- If segments or error are out of range, or
+ *                            memory could not be allocated.
+ */
+int chebyshev_moon_cache(unsigned int segments, double error)
+{
+	int ret;
+
+	if (segments < 1 || segments > CHEBYSHEV_MOON_CACHE_MAX ||
+		!(error > 0))
+		return ERR_UNSUPPORTED;
+
+	pthread_rwlock_wrlock(&moon_lock);
+	moon_cache.size = segments;
+	moon_cache.error = error;
+	__atomic_add_fetch(&moon_cache.generation, 1, __ATOMIC_RELAXED);
+	moon_cache.clock = 0;
+	moon_cache.misses = 0;
+	ret = alloc_moon_cache();
+	pthread_rwlock_unlock(&moon_lock);
+
+	return ret;
+}
+
+/*
+ * Returns the statistics of the Moon cache since it was last set up with
+ * chebyshev_moon_cache().
+ *
+ * hits -- The number of positions calculated from cached segments. The
+ *         hits of a thread in the segment it is in are only counted when
+ *         it moves to another segment.
+ * misses -- The number of segments that had to be fitted.
+ */
+void chebyshev_moon_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+	pthread_rwlock_rdlock(&moon_lock);
+	*misses = moon_cache.misses;
+	*hits = __atomic_load_n(&moon_cache.clock, __ATOMIC_RELAXED) -
+		moon_cache.misses;
+	pthread_rwlock_unlock(&moon_lock);
+}
+
+/*
+ * Calculates the Moon's position, and optionally its velocity, from a
+ * Chebyshev segment fitted to elp82b_coordinates() the first time the
+ * segment is needed, and kept in a cache shared by all threads. See
+ * chebyshev_moon_cache() for the size of the cache and the error bound.
+ *
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * pos -- The Moon's geocentric coordinates in KM, wrt the equinox & ecliptic
+ *        of J2000.
+ * vel -- If not NULL, the Moon's velocity in KM/day.
+ */
+void chebyshev_moon(struct julian_date *tdb, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	long index;
+	unsigned int generation;
+	double dt,tau,error;
+	struct moon_hint *h = &moon_hint;
+	struct moon_segment *s,seg;
+
+	dt = (tdb->date1 - J2000_EPOCH) + tdb->date2;
+	index = (long)floor(dt / CHEBYSHEV_MOON_SEGMENT);
+	tau = 2 * (dt - index * CHEBYSHEV_MOON_SEGMENT) /
+		CHEBYSHEV_MOON_SEGMENT - 1;
+
+	if (h->segment.index == index && h->generation ==
+			__atomic_load_n(&moon_cache.generation, __ATOMIC_RELAXED)) {
+		h->hits++;
+		evaluate(h->segment.c[0], MOON_NODES, h->segment.n, tau,
+			CHEBYSHEV_MOON_SEGMENT, pos, vel);
+		return;
+	}
+
+	pthread_rwlock_rdlock(&moon_lock);
+	generation = moon_cache.generation;
+	if (h->generation == generation)
+		__atomic_add_fetch(&moon_cache.clock, h->hits,
+				__ATOMIC_RELAXED);
+	h->hits = 0;
+
+	s = find_moon_segment(index);
+	if (s) {
+		__atomic_store_n(&s->used, __atomic_add_fetch(&moon_cache.clock,
+				1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		h->segment = *s;
+		h->generation = generation;
+		pthread_rwlock_unlock(&moon_lock);
+		evaluate(h->segment.c[0], MOON_NODES, h->segment.n, tau,
+			CHEBYSHEV_MOON_SEGMENT, pos, vel);
+		return;
+	}
+
+	error = moon_cache.error;
+	pthread_rwlock_unlock(&moon_lock);
+
+	fit_moon_segment(index, error, &seg);
+	evaluate(seg.c[0], MOON_NODES, seg.n, tau, CHEBYSHEV_MOON_SEGMENT,
+		pos, vel);
+	h->segment = seg;
+	h->generation = generation;
+
+	/*
+	 * Another thread may have added the segment meanwhile, or set up the
+	 * cache again with another error bound.
+	 */
+	pthread_rwlock_wrlock(&moon_lock);
+	if (moon_cache.generation == generation) {
+		moon_cache.clock++;
+		moon_cache.misses++;
+		if (!find_moon_segment(index) && (moon_cache.bucket ||
+				alloc_moon_cache() == SUCCESS))
+			add_moon_segment(&seg);
+	}
+	pthread_rwlock_unlock(&moon_lock);
+}
@@ -0,0 +1,113 @@
+/*
+ * chebyshev.h - Structs & declarations for Chebyshev ephemeris files
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHEBYSHEV_H_
+#define _CHEBYSHEV_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kepler.h>
+#include <julian_date.h>
+#include <coordinates.h>
+
+/*
+ * Bodies in a Chebyshev ephemeris, in addition to the planets in enum
+ * solar_system_planets. Each body keeps the units & reference frame of the
+ * theory it was fitted to:
+ *
+ * Planets -- vsop87_coordinates(). Heliocentric, AU, equinox & ecliptic of
+ *            J2000.
+ * Pluto   -- pluto_coordinates(). Heliocentric, AU, equinox & equator of
+ *            J2000.
+ * Moon    -- elp82b_coordinates(). Geocentric, KM, equinox & ecliptic of
+ *            J2000.
+ */
+#define CHEBYSHEV_PLUTO		(NEPTUNE + 1)
+#define CHEBYSHEV_MOON		(NEPTUNE + 2)
+#define CHEBYSHEV_BODY_COUNT	(NEPTUNE + 3)
+
+/* Largest degree of the polynomials in a segment */
+#define CHEBYSHEV_MAX_DEGREE	31
+
+/*
+ * chebyshev_moon() fits segments of CHEBYSHEV_MOON_SEGMENT days to the Moon
+ * as they are needed, and keeps them in a cache of CHEBYSHEV_MOON_CACHE_SIZE
+ * segments within CHEBYSHEV_MOON_ERROR KM, unless set up otherwise with
+ * chebyshev_moon_cache().
+ */
+#define CHEBYSHEV_MOON_SEGMENT		4.0
+#define CHEBYSHEV_MOON_CACHE_SIZE	64
+#define CHEBYSHEV_MOON_CACHE_MAX	65536
+#define CHEBYSHEV_MOON_ERROR		1E-3
+
+/*
+ * A Chebyshev ephemeris file starts with a struct chebyshev_file_header,
+ * in the byte order of the machine that wrote it. Each body's time span is
+ * divided into segments of equal length, and each segment holds the
+ * coefficients of x, y & z in that order, degree + 1 doubles each. The
+ * segments of a body follow one another at the offset given in its struct
+ * chebyshev_file_body, which is a multiple of CHEBYSHEV_FILE_ALIGNMENT.
+ * Files are created by examples/chebyshev_fit.
+ */
+#define CHEBYSHEV_FILE_MAGIC		"KEPCHEB"
+#define CHEBYSHEV_FILE_FORMAT		1
+#define CHEBYSHEV_FILE_BYTE_ORDER	0x01020304
+#define CHEBYSHEV_FILE_ALIGNMENT	64
+
+struct chebyshev_file_body {
+	int64_t offset;		/* Byte offset of the first segment */
+	int32_t degree;		/* Degree of the polynomials */
+	int32_t segments;	/* Number of segments */
+	double start;		/* Julian date (TDB) the first segment starts */
+	double length;		/* Length of a segment in days */
+	double error;		/* Largest error found by the fit, in the
+				   units of the body */
+};
+
+struct chebyshev_file_header {
+	char magic[8];		/* CHEBYSHEV_FILE_MAGIC */
+	int32_t format;		/* CHEBYSHEV_FILE_FORMAT */
+	int32_t byte_order;	/* CHEBYSHEV_FILE_BYTE_ORDER */
+	int32_t bodies;		/* Bit (1 << body) is set for every body present */
+	int32_t reserved;
+	struct chebyshev_file_body body[CHEBYSHEV_BODY_COUNT];
+};
+
+/* An ephemeris opened with chebyshev_open() */
+struct chebyshev_ephemeris {
+	unsigned int bodies;	/* Bit (1 << body) is set for every body present */
+	const struct chebyshev_file_header *header;  /* The mapped file */
+	size_t size;		/* Size of the mapped file */
+};
+
+int chebyshev_open(const char *path, struct chebyshev_ephemeris **eph);
+
+int chebyshev_state(struct chebyshev_ephemeris *eph, int body,
+		struct julian_date *tdb, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel);
+
+void chebyshev_close(struct chebyshev_ephemeris *eph);
+
+int chebyshev_moon_cache(unsigned int segments, double error);
+
+void chebyshev_moon_cache_stats(unsigned long *hits, unsigned long *misses);
+
+void chebyshev_moon(struct julian_date *tdb, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel);
+
+#endif
@@ -0,0 +1,500 @@
+/*
+ * codegen.c - Writes straight-line kernels for VSOP87 & ELP 2000-82B
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * codegen is run by the makefile when the library is built with
+ * generated=1. It is linked with vsop87_data.o & elp82b_data.o only, and
+ * writes every series of both theories out as C. See codegen.h.
+ *
+ * The series can be truncated, in the manner of vsop87_coordinates_tol().
+ * The smallest terms of each series are dropped as long as the sum of their
+ * amplitudes, times the largest |t|^k within 4000 years of J2000, stays
+ * within the series' share of the tolerance.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <kepler.h>
+#include <vsop87.h>
+#include <elp82b.h>
+#include <arg_reduction.h>
+#include <codegen.h>
+
+#define PLANET_SERIES_COUNT	VSOP87_SERIES_PER_BODY
+
+/* Frequencies are padded to a multiple of this, as in vsop87.c */
+#define FREQUENCY_PADDING	16
+
+/* Largest number of terms in one generated function */
+#define CHUNK_TERMS		1024
+
+/* Largest |t| in the time units of the theories, 4000 years from J2000 */
+#define VSOP87_SPAN		4.0
+#define ELP82B_SPAN		40.0
+
+/* Mean distance of the Moon in KM, to convert arcseconds to KM */
+#define MOON_DISTANCE		385000.0
+
+/* These arrays in vsop87_data.c & elp82b_data.c contain the theories */
+extern const struct vsop87_series planets_series[];
+extern void *elp_terms[];
+extern u_short elp_term_count[];
+
+static const char *planet_names[] = {"mercury","venus","earth","mars",
+				     "jupiter","saturn","uranus","neptune"};
+
+/* Amplitudes of the terms being sorted by keep_terms() */
+static const double *sort_amplitudes;
+
+/* Orders term indices by increasing absolute amplitude */
+static int compare_amplitude(const void *x, const void *y)
+{
+	double a1 = fabs(sort_amplitudes[*(const int *)x]);
+	double a2 = fabs(sort_amplitudes[*(const int *)y]);
+
+	return (a1 > a2) - (a1 < a2);
+}
+
+/* Orders doubles, for use with qsort() & bsearch() */
+static int compare_double(const void *x, const void *y)
+{
+	double c1 = *(const double *)x;
+	double c2 = *(const double *)y;
+
+	return (c1 > c2) - (c1 < c2);
+}
+
+/*
+ * Marks the terms of a series to be kept. The smallest terms are dropped
+ * while the sum of their amplitudes times scale stays within budget.
+ *
+ * a -- The amplitudes of the terms.
+ * n -- The number of terms.
+ * scale -- The largest factor the terms are multiplied with.
+ * budget -- The largest error allowed in the series.
+ * keep -- Set to 1 for every term kept and 0 for the others.
+ *
+ * Return: The number of terms kept, or -1 if memory could not be allocated.
+ */
+static int keep_terms(const double *a, int n, double scale, double budget,
+		char *keep)
+{
+	int i,kept,*order;
+	double dropped;
+
+	order = malloc((n + 1) * sizeof(int));
+	if (!order)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		order[i] = i;
+		keep[i] = 1;
+	}
+	sort_amplitudes = a;
+	qsort(order, n, sizeof(int), compare_amplitude);
+
+	kept = n;
+	dropped = 0;
+	for (i = 0; i < n; i++) {
+		dropped += fabs(a[order[i]]) * scale;
+		if (dropped > budget)
+			break;
+		keep[order[i]] = 0;
+		kept--;
+	}
+
+	free(order);
+	return kept;
+}
+
+/*
+ * Writes out the factored form of VSOP87 for a planet: the tables of
+ * unique frequencies for reduce_argument() and a function that sums up the
+ * 18 series from sin(c*t) & cos(c*t).
+ *
+ * fp -- The output file.
+ * planet -- The planet.
+ * tolerance -- The largest error in AU allowed in each coordinate.
+ * count -- The number of unique frequencies written out.
+ *
+ * Return: The number of terms written out, or -1 if memory could not be
+ *         allocated.
+ */
+static int write_planet(FILE *fp, int planet, double tolerance, int *count)
+{
+	int i,j,k,f,n,total,unique,acc;
+	char *keep;
+	double *freq,hi,lo,ac,as;
+	const struct vsop87_series *series,*s;
+
+	series = &planets_series[planet * PLANET_SERIES_COUNT];
+	for (i = 0, total = 0; i < PLANET_SERIES_COUNT; i++)
+		total += series[i].count;
+
+	keep = malloc(total);
+	freq = malloc((total + FREQUENCY_PADDING) * sizeof(double));
+	if (!keep || !freq) {
+		free(keep);
+		free(freq);
+		return -1;
+	}
+
+	/* Drop the smallest terms and collect the frequencies of the others */
+	for (i = 0, k = 0, n = 0; i < PLANET_SERIES_COUNT; i++) {
+		s = &series[i];
+		if (keep_terms(s->a, s->count, pow(VSOP87_SPAN, i % 6),
+				tolerance / 6, keep + k) < 0) {
+			free(keep);
+			free(freq);
+			return -1;
+		}
+		for (j = 0; j < s->count; j++) {
+			if (keep[k + j])
+				freq[n++] = s->c[j];
+		}
+		k += s->count;
+	}
+
+	qsort(freq, n, sizeof(double), compare_double);
+	for (i = 0, unique = 0; i < n; i++) {
+		if (unique == 0 || freq[i] != freq[unique - 1])
+			freq[unique++] = freq[i];
+	}
+	*count = (unique + FREQUENCY_PADDING - 1) / FREQUENCY_PADDING *
+		FREQUENCY_PADDING;
+
+	fprintf(fp, "static const double %s_rate_hi[%d] = {\n",
+		planet_names[planet], *count);
+	for (i = 0; i < *count; i++) {
+		reduction_rate(i < unique ? freq[i] : 0, 1.0,
+			JULIAN_MILLENNIUM_LENGTH, &hi, &lo);
+		fprintf(fp, "\t%a%s\n", hi, i < *count - 1 ? "," : "");
+	}
+	fprintf(fp, "};\n\nstatic const double %s_rate_lo[%d] = {\n",
+		planet_names[planet], *count);
+	for (i = 0; i < *count; i++) {
+		reduction_rate(i < unique ? freq[i] : 0, 1.0,
+			JULIAN_MILLENNIUM_LENGTH, &hi, &lo);
+		fprintf(fp, "\t%a%s\n", lo, i < *count - 1 ? "," : "");
+	}
+
+	/*
+	 * Each series is summed in 4 accumulators, so that consecutive terms
+	 * do not wait for one another.
+	 */
+	fprintf(fp, "};\n\nstatic void %s_sum(const double *s, const double *c,"
+		" double *sum)\n{\n\tdouble a0,a1,a2,a3;\n", planet_names[planet]);
+	for (i = 0, k = 0, n = 0; i < PLANET_SERIES_COUNT; i++) {
+		s = &series[i];
+		fprintf(fp, "\n\t/* %s %c%d */\n\ta0 = a1 = a2 = a3 = 0;\n",
+			planet_names[planet], "xyz"[i / 6], i % 6);
+		for (j = 0, acc = 0; j < s->count; j++) {
+			if (!keep[k + j])
+				continue;
+
+			ac = s->a[j] * cos(s->b[j]);
+			as = s->a[j] * sin(s->b[j]);
+			f = (double *)bsearch(&s->c[j], freq, unique,
+				sizeof(double), compare_double) - freq;
+			fprintf(fp, "\ta%d += %a * c[%d] %c %a * s[%d];\n", acc, ac,
+				f, as < 0 ? '+' : '-', fabs(as), f);
+			acc = (acc + 1) % 4;
+			n++;
+		}
+		fprintf(fp, "\tsum[%d] = (a0 + a1) + (a2 + a3);\n", i);
+		k += s->count;
+	}
+	fprintf(fp, "}\n\n");
+
+	free(keep);
+	free(freq);
+	return n;
+}
+
+/*
+ * Writes out the argument of a term of ELP 2000-82B.
+ *
+ * fp -- The output file.
+ * phi -- The phase of the term.
+ * mult -- The multipliers of the arguments, indexed by enum elp_argument.
+ */
+static void write_argument(FILE *fp, double phi, const int *mult)
+{
+	int k,first;
+	static const char *names[] = {"ELP_D","ELP_LP","ELP_L","ELP_F",
+				      "ELP_ZETA","ELP_ME","ELP_VE","ELP_T",
+				      "ELP_MA","ELP_JU","ELP_SA","ELP_UR",
+				      "ELP_NE"};
+
+	first = 1;
+	if (phi != 0) {
+		fprintf(fp, "%a", phi);
+		first = 0;
+	}
+
+	for (k = 0; k < ELP_W; k++) {
+		if (!mult[k])
+			continue;
+
+		if (!first)
+			fprintf(fp, " %c ", mult[k] < 0 ? '-' : '+');
+		else if (mult[k] < 0)
+			fprintf(fp, "-");
+		if (abs(mult[k]) != 1)
+			fprintf(fp, "%d * ", abs(mult[k]));
+		fprintf(fp, "arg[%s]", names[k]);
+		first = 0;
+	}
+
+	if (first)
+		fprintf(fp, "0");
+}
+
+/*
+ * Writes out a file of ELP 2000-82B as functions of at most CHUNK_TERMS
+ * terms each, named elpI_J.
+ *
+ * fp -- The output file.
+ * i -- The file, 1 to 36.
+ * scale -- The largest factor the terms are multiplied with.
+ * budget -- The largest error allowed in the file.
+ * chunks -- The number of functions written out.
+ *
+ * Return: The number of terms written out, or -1 if memory could not be
+ *         allocated.
+ */
+static int write_elp_file(FILE *fp, int i, double scale, double budget,
+		int *chunks)
+{
+	int j,n,count,acc,mult[ELP_ARGUMENTS];
+	char *keep;
+	double phi,*a;
+	const struct elp82b_term1 *p1;
+	const struct elp82b_term2 *p2;
+	const struct elp82b_term3 *p3;
+
+	count = elp_term_count[i];
+	keep = malloc(count + 1);
+	a = malloc((count + 1) * sizeof(double));
+	if (!keep || !a) {
+		free(keep);
+		free(a);
+		return -1;
+	}
+
+	p1 = elp_terms[i];
+	p2 = elp_terms[i];
+	p3 = elp_terms[i];
+	for (j = 0; j < count; j++) {
+		if (i <= 3)
+			a[j] = main_problem_amplitude(&p1[j], i);
+		else if (i >= 10 && i <= 21)
+			a[j] = p3[j].a;
+		else
+			a[j] = p2[j].a;
+	}
+	if (keep_terms(a, count, scale, budget, keep) < 0) {
+		free(keep);
+		free(a);
+		return -1;
+	}
+
+	/*
+	 * The terms are added from the end of the file, not in the order of
+	 * decreasing amplitude of elp82b_coordinates(). The difference stays
+	 * within ELP82B_BATCH_TOLERANCE.
+	 */
+	*chunks = 0;
+	for (j = count - 1, n = 0, acc = 0; j >= 0; j--) {
+		if (!keep[j])
+			continue;
+
+		if (n % CHUNK_TERMS == 0) {
+			if (n)
+				fprintf(fp, "\treturn (a0 + a1) + (a2 + a3);\n}\n\n");
+			fprintf(fp, "static double elp%d_%d(const double *arg)\n{\n"
+				"\tdouble a0,a1,a2,a3;\n\n\ta0 = a1 = a2 = a3 = 0;\n",
+				i, (*chunks)++);
+			acc = 0;
+		}
+
+		memset(mult, 0, sizeof(mult));
+		phi = 0;
+		if (i <= 3) {
+			mult[ELP_D] = p1[j].i1;
+			mult[ELP_LP] = p1[j].i2;
+			mult[ELP_L] = p1[j].i3;
+			mult[ELP_F] = p1[j].i4;
+		} else if (i >= 10 && i <= 21) {
+			phi = p3[j].phi;
+			mult[ELP_ME] = p3[j].i1;
+			mult[ELP_VE] = p3[j].i2;
+			mult[ELP_T] = p3[j].i3;
+			mult[ELP_MA] = p3[j].i4;
+			mult[ELP_JU] = p3[j].i5;
+			mult[ELP_SA] = p3[j].i6;
+			mult[ELP_UR] = p3[j].i7;
+			mult[ELP_L] = p3[j].i10;
+			mult[ELP_F] = p3[j].i11;
+			if (i <= 15) {
+				mult[ELP_NE] = p3[j].i8;
+				mult[ELP_D] = p3[j].i9;
+			} else {
+				mult[ELP_D] = p3[j].i8;
+				mult[ELP_LP] = p3[j].i9;
+			}
+		} else {
+			phi = p2[j].phi;
+			mult[ELP_ZETA] = p2[j].i1;
+			mult[ELP_D] = p2[j].i2;
+			mult[ELP_LP] = p2[j].i3;
+			mult[ELP_L] = p2[j].i4;
+			mult[ELP_F] = p2[j].i5;
+		}
+
+		fprintf(fp, "\ta%d += %a * %s(", acc, a[j], i == 3 ? "cos" : "sin");
+		write_argument(fp, phi, mult);
+		fprintf(fp, ");\n");
+		acc = (acc + 1) % 4;
+		n++;
+	}
+	if (n)
+		fprintf(fp, "\treturn (a0 + a1) + (a2 + a3);\n}\n\n");
+
+	free(keep);
+	free(a);
+	return n;
+}
+
+/*
+ * Returns the power of t that multiplies the terms of a file of
+ * ELP 2000-82B.
+ *
+ * i -- The file, 1 to 36.
+ *
+ * Return: 0, 1 or 2.
+ */
+static int elp_file_power(int i)
+{
+	if ((i >= 7 && i <= 9) || (i >= 13 && i <= 15) ||
+		(i >= 19 && i <= 21) || (i >= 25 && i <= 27))
+		return 1;
+	if (i >= 34 && i <= 36)
+		return 2;
+
+	return 0;
+}
+
+void display_usage()
+{
+	printf("Usage: codegen OUTPUT [VSOP87_TOLERANCE ELP82B_TOLERANCE]\n");
+	printf("Write the series of VSOP87 & ELP 2000-82B to OUTPUT as C"
+	       " functions. The\nsmallest terms are dropped while the error"
+	       " stays within VSOP87_TOLERANCE AU\nand ELP82B_TOLERANCE"
+	       " arcseconds within 4000 years of J2000 (default 0).\n");
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *fp;
+	int i,n,terms,chunks[37],count[NEPTUNE + 1];
+	double vsop87_tolerance,elp82b_tolerance,budget;
+
+	if (argc != 2 && argc != 4) {
+		display_usage();
+		return(1);
+	}
+
+	vsop87_tolerance = argc == 4 ? atof(argv[2]) : 0;
+	elp82b_tolerance = argc == 4 ? atof(argv[3]) : 0;
+	if (vsop87_tolerance < 0 || elp82b_tolerance < 0) {
+		fprintf(stderr, "Invalid tolerance\n");
+		return(1);
+	}
+
+	fp = fopen(argv[1], "w");
+	if (!fp) {
+		fprintf(stderr, "%s: cannot be written\n", argv[1]);
+		return(1);
+	}
+
+	fprintf(fp, "/*\n * generated.c - Written by codegen, do not edit\n"
+		" *\n * VSOP87 tolerance %g AU, ELP 2000-82B tolerance %g"
+		" arcseconds\n */\n\n#include <math.h>\n#include <memory.h>\n#include <codegen.h>\n\n",
+		vsop87_tolerance, elp82b_tolerance);
+
+	terms = 0;
+	for (i = MERCURY; i <= NEPTUNE; i++) {
+		n = write_planet(fp, i, vsop87_tolerance, &count[i]);
+		if (n < 0) {
+			fprintf(stderr, "Out of memory\n");
+			fclose(fp);
+			return(1);
+		}
+		terms += n;
+	}
+
+	fprintf(fp, "const struct generated_planet generated_planets[] = {\n");
+	for (i = MERCURY; i <= NEPTUNE; i++)
+		fprintf(fp, "\t{%d, %s_rate_hi, %s_rate_lo, %s_sum}%s\n", count[i],
+			planet_names[i], planet_names[i], planet_names[i],
+			i < NEPTUNE ? "," : "");
+	fprintf(fp, "};\n\n");
+	printf("VSOP87: %d terms\n", terms);
+
+	/*
+	 * Each variable gets the same share of the tolerance from each of its
+	 * 12 files. The distance is in KM.
+	 */
+	terms = 0;
+	for (i = 1; i <= 36; i++) {
+		budget = elp82b_tolerance / 12;
+		if (i % 3 == 0)
+			budget *= ACS_TO_RAD * MOON_DISTANCE;
+
+		n = write_elp_file(fp, i, pow(ELP82B_SPAN, elp_file_power(i)),
+			budget, &chunks[i]);
+		if (n < 0) {
+			fprintf(stderr, "Out of memory\n");
+			fclose(fp);
+			return(1);
+		}
+		terms += n;
+	}
+
+	fprintf(fp, "void generated_moon(const double *arg, double t,"
+		" double *lbr)\n{\n\tint k;\n\tdouble s[3][3];\n\n"
+		"\tmemset(s, 0, sizeof(s));\n");
+	for (i = 1; i <= 36; i++) {
+		for (n = 0; n < chunks[i]; n++)
+			fprintf(fp, "\ts[%d][%d] += elp%d_%d(arg);\n",
+				elp_file_power(i), (i - 1) % 3, i, n);
+	}
+	fprintf(fp, "\n\tfor (k = 0; k < 3; k++)\n\t\tlbr[k] = s[0][k] +"
+		" (s[1][k] + s[2][k] * t) * t;\n}\n");
+	printf("ELP 2000-82B: %d terms\n", terms);
+
+	if (fclose(fp)) {
+		fprintf(stderr, "%s: cannot be written\n", argv[1]);
+		return(1);
+	}
+
+	return(0);
+}
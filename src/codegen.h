@@ -0,0 +1,108 @@
+/*
+ * codegen.h - Declarations shared by the theories and the generated kernels
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * codegen.c writes generated.c, which evaluates VSOP87 & ELP 2000-82B with
+ * one straight-line function per series. The coefficients are immediates
+ * and every table index is a constant, so nothing is looked up through
+ * planets_series[] or elp_terms[] at run time. The library is built with
+ * generated.c by 'make target=posix generated=1', and the functions are
+ * then selected with VSOP87_KERNEL_GENERATED.
+ *
+ * This is an internal header, included by vsop87.c, elp82b.c, codegen.c and
+ * generated.c.
+ */
+
+#ifndef _CODEGEN_H_
+#define _CODEGEN_H_
+
+#include <kepler.h>
+#include <elp82b.h>
+
+/* Arguments of ELP 2000-82B, see elp_arguments() in elp82b.c */
+enum elp_argument {
+	ELP_D,
+	ELP_LP,
+	ELP_L,
+	ELP_F,
+	ELP_ZETA,
+	ELP_ME,
+	ELP_VE,
+	ELP_T,
+	ELP_MA,
+	ELP_JU,
+	ELP_SA,
+	ELP_UR,
+	ELP_NE,
+	ELP_W,
+	ELP_ARGUMENTS
+};
+
+/*
+ * The factored form of VSOP87 for a planet in generated.c. See struct
+ * factored_planet in vsop87.c.
+ */
+struct generated_planet {
+	int freq_count;		/* Unique frequencies, a multiple of 16 */
+	const double *rate_hi;	/* Frequencies for reduce_argument() */
+	const double *rate_lo;
+	void (*sum)(const double *sn, const double *cs, double *sum);
+};
+
+/* Indexed by enum solar_system_planets */
+extern const struct generated_planet generated_planets[];
+
+void generated_moon(const double *arg, double t, double *lbr);
+
+/*
+ * Calculates the amplitude of a term of the main problem of ELP 2000-82B,
+ * with the additive corrections to A. elp82b_init() works it out for every
+ * term when the library is loaded, and codegen when it writes out the
+ * terms. The tables in elp82b_data.c are left as they are.
+ *
+ * p1 -- The term.
+ * i -- The file of the term, 1 to 3.
+ *
+ * Return: The corrected amplitude.
+ */
+static __inline__ double main_problem_amplitude(const struct elp82b_term1 *p1,
+		int i)
+{
+	double m,alpha2_3m,d_nu,dnu2_3nu,y;
+
+	/* Constants needed for additive corrections to A in the main problem */
+	m = 129597742.2758 / 1732559343.73604;
+	alpha2_3m = 0.00514376267 / (3.0 * m);
+	d_nu = (-0.06424 - m * 0.55604) / 1732559343.73604;
+	dnu2_3nu = 1.11208 / 5197678031.20812;
+
+	/*
+	 * The following constants, fitted to DE200/LE200, are used to correct A
+	 * in the main problem. b2, b3 and b4 in elp82b_data.c have already been
+	 * multiplied with these values.
+	 * del_e (0".01789), del_eprime (-0".12879), del_g (-0".08066)
+	 */
+	y = p1->a + (p1->b1 + p1->b5 * alpha2_3m) * d_nu +
+		p1->b2 + p1->b3 + p1->b4;
+	if (i == 3)
+		y -= p1->a * dnu2_3nu;
+
+	return y;
+}
+
+#endif
@@ -23,178 +23,450 @@
 
 #include <math.h>
 #include <memory.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
 #include <kepler.h>
-#include <fund_args.h>
 #include <elp82b.h>
+#include <arg_reduction.h>
+#include <harmonic.h>
+#include <codegen.h>
 
 /* These arrays in elp82b_data.c contain the series of terms in the theory */
 extern void *elp_terms[];
 extern u_short elp_term_count[];
 
+/* Storage in elp82b_data.c for the corrected amplitudes of the main problem */
+extern double elp_main_amplitudes[];
+
+/* Storage in elp82b_data.c for the packed form of the files */
+extern signed char elp_packed_multipliers[];
+extern double elp_packed_amplitudes[];
+extern double elp_packed_tails[];
+
+/* elp_term_count as ints, for file_sums() */
+static int elp_file_count[37];
+
+/* The corrected amplitudes of files 1 to 3 in elp_main_amplitudes */
+static double *main_amplitudes[4];
+
 /*
- * Calculates the Moon's geocentric rectangular coordinates using the
- * ELP 2000-82B lunar theory in its entirety.
- *
- * tdb -- TDB to be used for calculations. TT may be used for all but the most
- *        exacting applications.
- * pos -- The Moon's geocentric rectangular coordinates in KM. The reference
- *        frame is the equinox & ecliptic of J2000.
+ * Polynomials in t (Julian centuries from J2000) of the arguments of the
+ * theory in arcseconds, indexed by enum elp_argument. The Delaunay
+ * arguments, the planetary longitudes & the Earth's mean longitude differ
+ * from the ones used in the IAU precession model, and the Moon's mean
+ * longitude is ARG_LONGITUDE_MOON. ZETA is the angle of the mean ecliptic
+ * of date wrt the equinox of J2000, corrected with the precessional constant.
  */
-void elp82b_coordinates(struct julian_date *tdb, struct rectangular_coordinates *pos)
-{
-	int i,j,k;
-	struct elp82b_term1 *p1;
-	struct elp82b_term2 *p2;
-	struct elp82b_term3 *p3;
-	double t,w,T,d,l,lp,f,m,alpha2_3m,d_nu,dnu2_3nu,zeta,me,ve,ma,ju,sa,
-		ur,ne,x,y,lbr1[3],lbr2[3],lbr3[3],U,V,r,P,Q,pm[3][3];
+static const double elp_polynomials[ELP_ARGUMENTS][5] = {
+	{1072260.73512, 1602961601.4603, -5.8681, 0.006595, -0.00003184},
+	{1287104.79306, 129596581.0474, -0.5529, 0.000147, 0},
+	{485868.28096, 1717915923.4728, 32.3893, 0.051651, -0.00024470},
+	{335779.55755, 1739527263.0983, -12.2505, -0.001021, 0.00000417},
+	{785939.95571, 1732564372.83264, 0, 0, 0},
+	{908103.25986, 538101628.68898, 0, 0, 0},
+	{655127.28305, 210664136.43355, 0, 0, 0},
+	{361679.22059, 129597742.2758, -0.0202, 0.000009, 0.00000015},
+	{1279559.78866, 68905077.59284, 0, 0, 0},
+	{123665.34212, 10925660.42861, 0, 0, 0},
+	{180278.89694, 4399609.65932, 0, 0, 0},
+	{1130598.01841, 1542481.19393, 0, 0, 0},
+	{1095655.19575, 786550.32074, 0, 0, 0},
+	{785939.95571, 1732559343.73604, -5.8883, 0.006604, -0.00003169}
+};
 
-	t = JULIAN_CENTURIES(tdb->date1, tdb->date2);
+/* The linear terms of elp_polynomials in radians per day */
+static double elp_rate_hi[ELP_ARGUMENTS],elp_rate_lo[ELP_ARGUMENTS];
 
-	/* Constants needed for additive corrections to A in the main problem */
-	m = 129597742.2758 / 1732559343.73604;
-	alpha2_3m = 0.00514376267 / (3.0 * m);
-	d_nu = (-0.06424 - m * 0.55604) / 1732559343.73604;
-	dnu2_3nu = 1.11208 / 5197678031.20812;
-
-	/*
-	 * The following constants, fitted to DE200/LE200, are used to correct A
-	 * in the main problem. b2, b3 and b4 in elp82b_data.c have already been
-	 * multiplied with these values.
-	 * del_e (0".01789), del_eprime (-0".12879), del_g (-0".08066)
-	 */
- 
-	/* 
-	 * Delaunay arguments. These expressions are different from the ones used
-	 * in the IAU precession model.
-	 */
-	d  = (1072260.73512 +
-		(1602961601.4603 +
-		(-5.8681 +
-		(0.006595 - 0.00003184 * t) * t) * t) * t) * ACS_TO_RAD;
-
-	lp = (1287104.79306 +
-		(129596581.0474 +
-		(-0.5529 + 0.000147 * t) * t) * t) * ACS_TO_RAD;
-
-	l  = (485868.28096 +
-		(1717915923.4728 +
-		(32.3893 +
-		(0.051651 - 0.00024470 * t) * t) * t) * t) * ACS_TO_RAD;
-
-	f  = (335779.55755 +
-		(1739527263.0983 +
-		(-12.2505 +
-		(-0.001021 + 0.00000417 * t) * t) * t) * t) * ACS_TO_RAD;
-
-	/*
-	 * Longitudes of the planets, used in calculating perturbations. They
-	 * are different from the ones used in the IAU precession model.
-	 */
-	me = (908103.25986 + 538101628.68898 * t) * ACS_TO_RAD;
-	ve = (655127.28305 + 210664136.43355 * t) * ACS_TO_RAD;
-	ma = (1279559.78866 + 68905077.59284 * t) * ACS_TO_RAD;
-	ju = (123665.34212 + 10925660.42861 * t) * ACS_TO_RAD;
-	sa = (180278.89694 + 4399609.65932 * t) * ACS_TO_RAD;
-	ur = (1130598.01841 + 1542481.19393 * t) * ACS_TO_RAD;
-	ne = (1095655.19575 + 786550.32074 * t) * ACS_TO_RAD;
-
-	/*
-	 * Mean longitude of the earth. A different expression from the argument
-	 * ARG_LONGITUDE_EARTH used in the IAU precession model.
-	 */
-	T = (361679.22059 +
-		(129597742.2758 +
-		(-0.0202 +
-		(0.000009 + 0.00000015 * t) * t) * t) * t) * ACS_TO_RAD;
+/*
+ * The single precision form of the theory gathers the terms of the files
+ * that share an argument layout, a variable (longitude, latitude or
+ * distance) and a power of t into one series of terms
+ * A*sin(phi + m1*a1 + m2*a2 + ...). The amplitudes, phases & multipliers are
+ * kept in separate float arrays, padded with zero terms to a multiple of
+ * FAST_PADDING and sorted by increasing amplitude, so that the float sums
+ * grow gradually. The distance terms A*cos(x) of the main problem become
+ * A*sin(x + PI/2).
+ */
+#define FAST_PADDING		16
+#define FAST_MAX_ARGUMENTS	11
+#define FAST_LAYOUTS		4
+#define FAST_SERIES_COUNT	(FAST_LAYOUTS * 3 * 3)
+#define FAST_ARG_STRIDE		16
+#define FAST_BLOCK_SIZE		8
 
-	/* Mean longitude of the moon */
-	w = fundamental_argument(ARG_LONGITUDE_MOON, t);
+struct fast_series {
+	int count;
+	int arg_count;
+	const int *arg;
+	float *amp;
+	float *phase;
+	float *mult[FAST_MAX_ARGUMENTS];
+};
 
-	/*
-	 * Angle of mean ecliptic of date wrt equinox of J2000, corrected with
-	 * the precessional constant.
-	 */
-	zeta = (785939.95571 + 1732564372.83264 * t) * ACS_TO_RAD;
+/* The arguments multiplied by i1, i2... in each layout of the files */
+static const int layout_args[FAST_LAYOUTS][FAST_MAX_ARGUMENTS] = {
+	/* Main problem, files elp1 to elp3 */
+	{ELP_D, ELP_LP, ELP_L, ELP_F},
+	/* Perturbations other than planetary, files elp4 to elp9, elp22 to elp36 */
+	{ELP_ZETA, ELP_D, ELP_LP, ELP_L, ELP_F},
+	/* Planetary perturbations, files elp10 to elp15 */
+	{ELP_ME, ELP_VE, ELP_T, ELP_MA, ELP_JU, ELP_SA, ELP_UR, ELP_NE, ELP_D,
+		ELP_L, ELP_F},
+	/* Planetary perturbations, files elp16 to elp21 */
+	{ELP_ME, ELP_VE, ELP_T, ELP_MA, ELP_JU, ELP_SA, ELP_UR, ELP_D, ELP_LP,
+		ELP_L, ELP_F}
+};
 
-	memset(lbr1, 0, sizeof(lbr1));
-	memset(lbr2, 0, sizeof(lbr2));
-	memset(lbr3, 0, sizeof(lbr3));
+static const int layout_arg_count[FAST_LAYOUTS] = {4, 5, 11, 11};
 
-	/* Main problem, files elp1 to elp3 */
+/* A term of any file, in the form used by the single precision series */
+struct fast_term {
+	double amp;
+	double phase;
+	int mult[FAST_MAX_ARGUMENTS];
+};
+
+static struct fast_series fast_series[FAST_SERIES_COUNT];
+static int fast_ready;
+static void *fast_mem;
+
+/* Serializes building the single precision form of the theory */
+static pthread_mutex_t fast_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void fast_sum_scalar(const struct fast_series *s, const float *arg,
+		int m, double *sum);
+
+static int file_layout(int i);
+
+static int file_power(int i);
+
+/*
+ * The series are summed up from a packed copy of the files, built on first
+ * use. Only the multipliers of a term that are not zero are kept, as signed
+ * chars, which skips two thirds of the products in the planetary terms.
+ * The amplitudes are kept in arrays of their own: the corrected amplitude
+ * in the main problem, A*cos(phi) & A*sin(phi) in the other files. A call
+ * of elp82b_coordinates() or elp82b_state() then reads 0.9 MB rather than
+ * the 1.5 MB of the files. The files themselves are kept, for
+ * elp82b_coordinates_batch(), elp82b_coordinates_fast() & codegen, so the
+ * packed copy adds to the memory of the theory: 1.2 MB of the 1.8 MB set
+ * aside for it in elp82b_data.c are filled. The terms of each file are in
+ * order of decreasing amplitude, and tail[j] holds the sum of the amplitudes
+ * from term j onwards.
+ */
+struct packed_file {
+	const signed char *m;	/* Multipliers, see pack_term() */
+	const double *a;	/* Amplitudes, or A*cos(phi) */
+	const double *b;	/* A*sin(phi), except in the main problem */
+	const double *tail;
+};
+
+static struct packed_file packed_files[37];
+static int packed_ready;
+
+/* Whether the packed terms are in order of decreasing amplitude */
+static int packed_sorted;
+
+/*
+ * For truncated evaluation, a plan keeps the leading terms of every packed
+ * file for a tolerance and for epochs within a span of J2000, a power of 2
+ * of Julian centuries. It is reused for every epoch within the span as long
+ * as the tolerance is the same. Up to TOL_PLANS plans are kept.
+ */
+#define TOL_PLANS	8
+
+/* Mean distance of the Moon in KM, to convert arcseconds to KM */
+#define MOON_DISTANCE	385000.0
+
+struct tol_plan {
+	double tolerance;
+	double span;
+	int count[37];
+};
+
+/* A term of a file and its amplitude times the power of t, for sorting */
+struct ranked_term {
+	double amplitude;
+	int file;
+	int index;
+};
+
+static struct tol_plan tol_plans[TOL_PLANS];
+static int tol_plan_count,tol_plan_next;
+
+/* Serializes building the packed files and the plans */
+static pthread_mutex_t tol_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct packed_file *get_packed_files(void);
+
+/*
+ * The files are summed up in chunks of at most ELP_CHUNK terms, whose sums
+ * are added up in order. With elp82b_set_threads(), a pool of persistent
+ * threads shares out the chunks of elp82b_coordinates(), and the caller adds
+ * up their sums in the same order, so the result does not depend on the
+ * number of threads. The pool serves one call at a time, and other calls
+ * meanwhile sum up the theory by themselves.
+ */
+#define ELP_CHUNK	2048
+
+struct elp_chunk {
+	int file;
+	int start;		/* The first term of the chunk */
+	int count;		/* The number of terms */
+	long size;		/* Bytes of multipliers, a measure of the cost */
+	const signed char *m;	/* The multipliers of the first term */
+};
+
+static struct elp_pool {
+	int threads;		/* Threads summing up, the caller included */
+	int quit;
+	int pending;		/* Threads yet to finish the call */
+	unsigned long generation;  /* Number of calls since the pool started */
+	pthread_t tid[ELP82B_MAX_THREADS];
+	int first[ELP82B_MAX_THREADS + 1];  /* The chunks of each thread */
+	int chunk_count;
+	struct elp_chunk *chunks;
+	double *partial;	/* The sum of each chunk */
+	const struct harmonic_table *(*h)[FAST_MAX_ARGUMENTS];
+} pool = {1};
+
+/* Held by the call using the pool, and while the pool is set up */
+static pthread_mutex_t pool_call_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Guards generation, pending & quit */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+
+/* Epochs summed up together by elp82b_coordinates_batch() */
+#define BATCH_BLOCK_SIZE	16
+
+/*
+ * Sums up a file for a block of epochs in double precision, or NULL to
+ * calculate every epoch with elp82b_coordinates().
+ */
+static void (*batch_sum)(int i, const double *arg, double *sum);
+
+/*
+ * Rotation from the ecliptic of J2000 to the equator of J2000/FK5, as
+ * specified in the theory
+ */
+static double elp_equator_matrix[3][3] = {
+	{ 1.000000000000, 0.000000437913, -0.000000189859},
+	{-0.000000477299, 0.917482137607, -0.397776981701},
+	{ 0.000000000000, 0.397776981701,  0.917482137607}
+};
+
+static void (*fast_sum)(const struct fast_series *s, const float *arg,
+		int m, double *sum) = fast_sum_scalar;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ELP82B_X86_KERNELS
+
+#define KERNEL_SUFFIX	sse2
+#define KERNEL_TARGET	"sse2"
+#define KERNEL_WIDTH	4
+#include <elp82b_kernel.h>
+
+#define KERNEL_SUFFIX	avx2
+#define KERNEL_TARGET	"avx2,fma"
+#define KERNEL_WIDTH	8
+#include <elp82b_kernel.h>
+
+#define KERNEL_SUFFIX	avx512
+#define KERNEL_TARGET	"avx512f"
+#define KERNEL_WIDTH	16
+#include <elp82b_kernel.h>
+#endif
+
+#ifdef __GNUC__
+#define ELP82B_GENERIC_KERNEL
+
+/* Same bits on every CPU, as VSOP87_KERNEL_REPRODUCIBLE */
+#define KERNEL_SUFFIX	generic
+#define KERNEL_WIDTH	4
+#include <elp82b_kernel.h>
+
+/* Keeps a*b + c from being fused, as in the reproducible kernel */
+#define NO_CONTRACT	__attribute__((optimize("fp-contract=off")))
+#else
+#define NO_CONTRACT
+#endif
+
+static enum vsop87_kernel current_kernel = VSOP87_KERNEL_SCALAR;
+
+/*
+ * Works out the corrected amplitudes of the main problem, converts the
+ * rates of the arguments and selects the fastest single precision kernel
+ * supported by the CPU. Called automatically when the library is loaded.
+ */
+static void __attribute__((constructor)) elp82b_init(void)
+{
+	int i,j,k;
+	const struct elp82b_term1 *p1;
+
+	/* The corrections to the amplitudes of the main problem are constant */
+	main_amplitudes[1] = elp_main_amplitudes;
 	for (i = 1; i <= 3; i++) {
-		k = i - 1;
 		p1 = elp_terms[i];
-		for (j = elp_term_count[i] - 1; j >= 0; j--) {
-			x = p1->i1 * d + p1->i2 * lp + p1->i3 * l + p1->i4 * f;
-			y = p1->a + (p1->b1 + p1->b5 * alpha2_3m) * d_nu +
-				p1->b2 + p1->b3 + p1->b4;
-			if (i != 3) {
-				lbr1[k] += y * sin(x);
-			} else {
-				y -= p1->a * dnu2_3nu;
-				lbr1[k] += y * cos(x);
-			}
-			p1++;
-		}
+		for (j = 0; j < elp_term_count[i]; j++)
+			main_amplitudes[i][j] = main_problem_amplitude(&p1[j], i);
+		if (i < 3)
+			main_amplitudes[i + 1] = main_amplitudes[i] + j;
 	}
 
-	/* 
-	 * Perturbations: Earth (elp4-elp9), tidal effects (elp22-elp27),
-	 * Moon (elp28-elp30), relativistic (elp31-elp33), planetary effects
-	 * on solar eccentricity (elp34-elp36).
-	 */
-	for (i = 4; i <= 36; i++) {
-		if (i >= 10 && i <= 21)
-			continue;
+	for (i = 1; i <= 36; i++)
+		elp_file_count[i] = elp_term_count[i];
 
-		k = (i - 1) % 3;
-		p2 = elp_terms[i];
-		for (j = elp_term_count[i] - 1; j >= 0; j--) {
-			x = p2->i1 * zeta + p2->i2 * d + p2->i3 * lp +
-				p2->i4 * l + p2->i5 * f + p2->phi;
-			y = p2->a;
-			if ((i >= 7 && i <= 9) || (i >= 25 && i <= 27))
-				y *= t;
-			if (i >= 34 && i <= 36)
-				y = (y * t) * t;
-			lbr2[k] += y * sin(x);
-			p2++;
-		}
+	for (k = 0; k < ELP_ARGUMENTS; k++)
+		reduction_rate(elp_polynomials[k][1], ACS_TO_RAD,
+			JULIAN_CENTURY_LENGTH, &elp_rate_hi[k], &elp_rate_lo[k]);
+
+	for (k = VSOP87_KERNEL_AVX512; k >= VSOP87_KERNEL_SCALAR; k--) {
+		if (elp82b_set_kernel(k) == SUCCESS)
+			break;
 	}
+}
 
-	/* Planetary perturbations, files elp10 to elp21 */
-	for (i = 10; i <= 21; i++) {
-		k = (i - 1) % 3;
-		p3 = elp_terms[i];
-		for (j = elp_term_count[i] - 1; j >= 0; j--) {
-			x = p3->phi + p3->i1 * me + p3->i2 * ve + p3->i3 * T +
-				p3->i4 * ma + p3->i5 * ju + p3->i6 * sa +
-				p3->i7 * ur + p3->i10 * l + p3->i11 * f;
-			if (i <= 15) {
-				x += p3->i8 * ne + p3->i9 * d;
-			} else {
-				x += p3->i8 * d + p3->i9 * lp;
-			}
-			y = p3->a;
-			if ((i >= 13 && i <= 15) || (i >= 19 && i <= 21))
-				y *= t;
-			lbr3[k] += y * sin(x);
-			p3++;
-		}
+/*
+ * Selects the routine used to sum up the series in elp82b_coordinates_fast()
+ * and elp82b_coordinates_batch(). The fastest one supported by the CPU is
+ * selected when the library is loaded. VSOP87_KERNEL_SCALAR uses sinf() from
+ * the C library, and calls elp82b_coordinates() for every epoch of a batch.
+ * VSOP87_KERNEL_REPRODUCIBLE gives the same bits on every CPU as long as the
+ * C library's sin() & cos() do. elp82b_coordinates() does not depend on the
+ * kernel, except that VSOP87_KERNEL_GENERATED makes it use the generated
+ * straight-line code, see vsop87.h.
+ *
+ * kernel -- The kernel to be used.
+ *
+ * Return: SUCCESS -- If the kernel has been selected.
+ *         ERR_UNSUPPORTED -- If the kernel is unknown or the CPU does not
+ *                            support its instruction set.
+ */
+int elp82b_set_kernel(enum vsop87_kernel kernel)
+{
+	void (*sum)(const struct fast_series *s, const float *arg, int m,
+		double *sum);
+	void (*batch)(int i, const double *arg, double *sum) = NULL;
+
+	switch (kernel) {
+	case VSOP87_KERNEL_SCALAR:
+		sum = fast_sum_scalar;
+		break;
+#ifdef ELP82B_X86_KERNELS
+	case VSOP87_KERNEL_SSE2:
+		__builtin_cpu_init();
+		sum = __builtin_cpu_supports("sse2") ? fast_sum_sse2 : NULL;
+		batch = batch_sum_sse2;
+		break;
+	case VSOP87_KERNEL_AVX2:
+		__builtin_cpu_init();
+		sum = __builtin_cpu_supports("avx2") &&
+			__builtin_cpu_supports("fma") ? fast_sum_avx2 : NULL;
+		batch = batch_sum_avx2;
+		break;
+	case VSOP87_KERNEL_AVX512:
+		__builtin_cpu_init();
+		sum = __builtin_cpu_supports("avx512f") ? fast_sum_avx512 : NULL;
+		batch = batch_sum_avx512;
+		break;
+#endif
+#ifdef ELP82B_GENERIC_KERNEL
+	case VSOP87_KERNEL_REPRODUCIBLE:
+		sum = fast_sum_generic;
+		batch = batch_sum_generic;
+		break;
+#endif
+#if defined(ELP82B_GENERIC_KERNEL) && defined(KEPLER_GENERATED)
+	case VSOP87_KERNEL_GENERATED:
+		sum = fast_sum_generic;
+		break;
+#endif
+	default:
+		sum = NULL;
+		break;
 	}
 
-	/* Sum up the individual contributions */
-	V = reduce_angle(w + (lbr1[0] + lbr2[0] + lbr3[0]) * ACS_TO_RAD, TWO_PI);
-	U = (lbr1[1] + lbr2[1] + lbr3[1]) * ACS_TO_RAD;
-	r = (lbr1[2] + lbr2[2] + lbr3[2])* 384747.9806448954 / 384747.9806743165;
+	if (!sum)
+		return ERR_UNSUPPORTED;
 
-	/* Convert to rectangular coordinates */
-	pos->x = r * cos(V) * cos(U);
-	pos->y = r * sin(V) * cos(U);
-	pos->z = r * sin(U);
+	fast_sum = sum;
+	batch_sum = batch;
+	current_kernel = kernel;
+	return SUCCESS;
+}
+
+/*
+ * Returns the routine currently used to sum up the series in
+ * elp82b_coordinates_fast().
+ *
+ * Return: The kernel selected by elp82b_set_kernel().
+ */
+enum vsop87_kernel elp82b_get_kernel(void)
+{
+	return current_kernel;
+}
+
+/*
+ * Calculates the arguments of the theory. The linear terms are reduced by
+ * 2*PI exactly, so that the arguments are as accurate far from J2000 as they
+ * are near it.
+ *
+ * tdb -- The epoch.
+ * arg -- The arguments in radians between -PI & PI, indexed by enum
+ *        elp_argument.
+ */
+static NO_CONTRACT void elp_arguments(const struct julian_date *tdb,
+		double *arg)
+{
+	int k;
+	double t,x,whole,frac;
+	const double *p;
+
+	t = JULIAN_CENTURIES(tdb->date1, tdb->date2);
+	reduction_days(tdb, &whole, &frac);
+	for (k = 0; k < ELP_ARGUMENTS; k++) {
+		p = elp_polynomials[k];
+		x = reduce_argument(elp_rate_hi[k], elp_rate_lo[k], whole, frac) +
+			(p[0] + (p[2] + (p[3] + p[4] * t) * t) * t * t) *
+			ACS_TO_RAD;
+		arg[k] = x - TWO_PI * floor(x / TWO_PI + 0.5);
+	}
+}
+
+/*
+ * Calculates the rates of the arguments of the theory.
+ *
+ * t -- The epoch in Julian centuries from J2000.
+ * rate -- The rates of the arguments in radians per Julian century.
+ */
+static void elp_argument_rates(double t, double *rate)
+{
+	int k;
+	const double *p;
+
+	for (k = 0; k < ELP_ARGUMENTS; k++) {
+		p = elp_polynomials[k];
+		rate[k] = (p[1] + (2 * p[2] + (3 * p[3] + 4 * p[4] * t) * t) *
+			t) * ACS_TO_RAD;
+	}
+}
+
+/*
+ * Sets up the matrix for the precession of the mean ecliptic of date to
+ * the mean ecliptic of J2000, and optionally its rate.
+ *
+ * t -- The epoch in Julian centuries from J2000.
+ * pm -- The precession matrix.
+ * dpm -- If not NULL, the rate of the precession matrix per Julian century.
+ */
+static NO_CONTRACT void elp_precession(double t, double pm[3][3],
+		double dpm[3][3])
+{
+	double P,Q,S,dP,dQ,dS;
 
-	/* Set up precession matrix for conversion to the mean ecliptic of J2000 */
 	P = (0.10180391E-4 +
 		(0.47020439E-6 +
 		(-0.5417367E-9 +
@@ -219,24 +491,1477 @@ void elp82b_coordinates(struct julian_date *tdb, struct rectangular_coordinates
 	pm[2][1] = -pm[1][2];
 	pm[2][2] = 1.0 - (2.0 * P) * P - (2.0 * Q) * Q;
 
+	if (!dpm)
+		return;
+
+	dP = 0.10180391E-4 +
+		(2 * 0.47020439E-6 +
+		(3 * -0.5417367E-9 +
+		(4 * -0.2507948E-11 +
+		5 * 0.463486E-14 * t) * t) * t) * t;
+
+	dQ = -0.113469002E-3 +
+		(2 * 0.12372674E-6 +
+		(3 * 0.12654170E-8 +
+		(4 * -0.1371808E-11 +
+		5 * -0.320334E-14 * t) * t) * t) * t;
+
+	S = sqrt(1.0 - P * P - Q * Q);
+	dS = -(P * dP + Q * dQ) / S;
+
+	dpm[0][0] = -4.0 * P * dP;
+	dpm[0][1] = 2.0 * (dP * Q + P * dQ);
+	dpm[0][2] = 2.0 * (dP * S + P * dS);
+
+	dpm[1][0] = dpm[0][1];
+	dpm[1][1] = -4.0 * Q * dQ;
+	dpm[1][2] = -2.0 * (dQ * S + Q * dS);
+
+	dpm[2][0] = -dpm[0][2];
+	dpm[2][1] = -dpm[1][2];
+	dpm[2][2] = -4.0 * (P * dP + Q * dQ);
+}
+
+/*
+ * Converts the sums of the series to the Moon's rectangular coordinates in
+ * the ecliptic frame of J2000, or the equatorial frame of J2000/FK5.
+ *
+ * t -- The epoch in Julian centuries from J2000.
+ * w -- The mean longitude of the Moon.
+ * lbr -- The sums for the longitude & latitude in arcseconds and the
+ *        distance in KM.
+ * frame -- ELP82B_FRAME_ECLIPTIC or ELP82B_FRAME_EQUATORIAL.
+ * pos -- The Moon's geocentric rectangular coordinates in KM.
+ */
+static NO_CONTRACT void elp_to_rectangular(double t, double w,
+		const double *lbr, int frame, struct rectangular_coordinates *pos)
+{
+	int i,j;
+	double U,V,r,pm[3][3],em[3][3];
+
+	/* Add the mean longitude & correct the distance */
+	V = reduce_angle(w + lbr[0] * ACS_TO_RAD, TWO_PI);
+	U = lbr[1] * ACS_TO_RAD;
+	r = lbr[2] * 384747.9806448954 / 384747.9806743165;
+
+	/* Convert to rectangular coordinates */
+	pos->x = r * cos(V) * cos(U);
+	pos->y = r * sin(V) * cos(U);
+	pos->z = r * sin(U);
+
+	/* Set up precession matrix for conversion to the mean ecliptic of J2000 */
+	elp_precession(t, pm, NULL);
+
 	/* Rotate the moon's coordinates to the mean ecliptic of J2000 */
-	rotate_rectangular(pm, pos);
+	if (frame != ELP82B_FRAME_EQUATORIAL) {
+		rotate_rectangular(pm, pos);
+		return;
+	}
+
+	/* Or on to the equator in the same rotation */
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			em[i][j] = elp_equator_matrix[i][0] * pm[0][j] +
+				elp_equator_matrix[i][1] * pm[1][j] +
+				elp_equator_matrix[i][2] * pm[2][j];
+		}
+	}
+	rotate_rectangular(em, pos);
 }
 
 /*
- * Rotates the Moon's coordinates from the ecliptic frame of J2000 to the
- * equatorial frame of J2000/FK5.
+ * Sums up a run of terms of a file of the main problem. The amplitudes have
+ * been corrected by elp82b_init() before they were packed.
  *
- * pos -- The coordinates to be rotated in-place
+ * f -- The packed file.
+ * first -- The first term to be summed up.
+ * n -- The number of terms to be summed up.
+ * m -- The multipliers of term first, advanced past the last term.
+ * h -- The tables of the arguments of the theory.
+ * cosine -- Whether the terms are A*cos(x) rather than A*sin(x). It is a
+ *           constant at every call, so the loop does not branch on it.
+ *
+ * Return: The sum of the terms.
  */
-void elp82b_ecliptic_to_equator(struct rectangular_coordinates *pos)
+static __inline__ double main_problem_sum(const struct packed_file *f,
+		int first, int n, const signed char **m,
+		const struct harmonic_table *const *h, int cosine)
+{
+	int j;
+	double sn,cs,sum;
+	const signed char *p = *m;
+
+	sum = 0;
+	for (j = first; j < first + n; j++) {
+		p = harmonic_sincos_sparse(p, h, &sn, &cs);
+		sum += f->a[j] * (cosine ? cs : sn);
+	}
+
+	*m = p;
+	return sum;
+}
+
+/*
+ * Sums up a run of terms of a file of the perturbations, without the power
+ * of t that multiplies them.
+ *
+ * f -- The packed file 4 to 36.
+ * first -- The first term to be summed up.
+ * n -- The number of terms to be summed up.
+ * m -- The multipliers of term first, advanced past the last term.
+ * h -- The tables of the arguments in the layout of the file, as given by
+ *      layout_args.
+ *
+ * Return: The sum of the terms.
+ */
+static double perturbation_sum(const struct packed_file *f, int first,
+		int n, const signed char **m,
+		const struct harmonic_table *const *h)
+{
+	int j;
+	double sn,cs,sum;
+	const signed char *p = *m;
+
+	sum = 0;
+	for (j = first; j < first + n; j++) {
+		p = harmonic_sincos_sparse(p, h, &sn, &cs);
+		sum += f->a[j] * sn + f->b[j] * cs;
+	}
+
+	*m = p;
+	return sum;
+}
+
+/*
+ * Returns the rate of the argument of a packed term.
+ *
+ * m -- The multipliers of the term.
+ * rate -- The rates of the arguments in the layout of the file.
+ *
+ * Return: The sum of the multipliers times the rates.
+ */
+static __inline__ double packed_rate(const signed char *m, const double *rate)
+{
+	int j;
+	double w;
+
+	w = 0;
+	for (j = *m++; j > 0; j--, m += 2)
+		w += m[1] * rate[m[0]];
+
+	return w;
+}
+
+/*
+ * Sums up a run of terms of a file of the main problem and their rates.
+ *
+ * f -- The packed file.
+ * first -- The first term to be summed up.
+ * n -- The number of terms to be summed up.
+ * m -- The multipliers of term first, advanced past the last term.
+ * h -- The tables of the arguments of the theory.
+ * rate -- The rates of the arguments, in the order of h.
+ * cosine -- Whether the terms are A*cos(x) rather than A*sin(x).
+ * dot -- The sum of the rates of the terms.
+ *
+ * Return: The sum of the terms.
+ */
+static __inline__ double main_problem_sum_dot(const struct packed_file *f,
+		int first, int n, const signed char **m,
+		const struct harmonic_table *const *h, const double *rate,
+		int cosine, double *dot)
+{
+	int j;
+	double sn,cs,w,sum,dsum;
+	const signed char *p = *m;
+
+	sum = 0;
+	dsum = 0;
+	for (j = first; j < first + n; j++) {
+		w = f->a[j] * packed_rate(p, rate);
+		p = harmonic_sincos_sparse(p, h, &sn, &cs);
+		sum += f->a[j] * (cosine ? cs : sn);
+		dsum += w * (cosine ? -sn : cs);
+	}
+
+	*m = p;
+	*dot = dsum;
+	return sum;
+}
+
+/*
+ * Sums up a run of terms of a file of the perturbations and their rates,
+ * without the power of t that multiplies them.
+ *
+ * f -- The packed file 4 to 36.
+ * first -- The first term to be summed up.
+ * n -- The number of terms to be summed up.
+ * m -- The multipliers of term first, advanced past the last term.
+ * h -- The tables of the arguments in the layout of the file, as given by
+ *      layout_args.
+ * rate -- The rates of the arguments, in the order of h.
+ * dot -- The sum of the rates of the terms.
+ *
+ * Return: The sum of the terms.
+ */
+static double perturbation_sum_dot(const struct packed_file *f, int first,
+		int n, const signed char **m,
+		const struct harmonic_table *const *h, const double *rate,
+		double *dot)
+{
+	int j;
+	double sn,cs,w,sum,dsum;
+	const signed char *p = *m;
+
+	sum = 0;
+	dsum = 0;
+	for (j = first; j < first + n; j++) {
+		w = packed_rate(p, rate);
+		p = harmonic_sincos_sparse(p, h, &sn, &cs);
+		sum += f->a[j] * sn + f->b[j] * cs;
+		dsum += w * (f->a[j] * cs - f->b[j] * sn);
+	}
+
+	*m = p;
+	*dot = dsum;
+	return sum;
+}
+
+/*
+ * Sums up a chunk of a file, at most ELP_CHUNK terms, and optionally their
+ * rates.
+ *
+ * files -- The packed files, 1 to 36.
+ * i -- The file.
+ * first -- The first term of the chunk.
+ * n -- The number of terms in the chunk.
+ * m -- The multipliers of term first, advanced past the chunk.
+ * h -- The tables of the arguments in each layout.
+ * r -- The rates of the arguments in each layout, or NULL.
+ * dot -- The sum of the rates of the terms if r is not NULL.
+ *
+ * Return: The sum of the terms.
+ */
+static double chunk_sum(const struct packed_file *files, int i, int first,
+		int n, const signed char **m,
+		const struct harmonic_table *(*h)[FAST_MAX_ARGUMENTS],
+		double (*r)[FAST_MAX_ARGUMENTS], double *dot)
+{
+	int k = file_layout(i);
+
+	if (r) {
+		if (i <= 3)
+			return main_problem_sum_dot(&files[i], first, n, m,
+				h[0], r[0], i == 3, dot);
+		return perturbation_sum_dot(&files[i], first, n, m, h[k],
+			r[k], dot);
+	}
+
+	if (i <= 3)
+		return main_problem_sum(&files[i], first, n, m, h[0], i == 3);
+	return perturbation_sum(&files[i], first, n, m, h[k]);
+}
+
+/*
+ * Tabulates the multiples of the arguments of the theory, and orders the
+ * tables and the rates of the arguments for each layout of the files.
+ *
+ * arg -- The arguments of the theory.
+ * rate -- The rates of the arguments, or NULL.
+ * tab -- The tables of the arguments.
+ * h -- The tables in each layout.
+ * r -- The rates in each layout if rate is not NULL.
+ */
+static void argument_tables(const double *arg, const double *rate,
+		struct harmonic_table *tab,
+		const struct harmonic_table *h[][FAST_MAX_ARGUMENTS],
+		double (*r)[FAST_MAX_ARGUMENTS])
+{
+	int i,j;
+
+	for (i = 0; i < ELP_W; i++)
+		harmonic_table(arg[i], HARMONIC_MAX_MULTIPLE, &tab[i]);
+	for (i = 0; i < FAST_LAYOUTS; i++) {
+		for (j = 0; j < layout_arg_count[i]; j++) {
+			h[i][j] = &tab[layout_args[i][j]];
+			r[i][j] = rate ? rate[layout_args[i][j]] : 0;
+		}
+	}
+}
+
+/*
+ * Adds up the sums of the files of the theory, in the same order whether
+ * they were summed up by one thread or by the worker pool.
+ *
+ * t -- Julian centuries from J2000.
+ * x -- The sums of the files, 1 to 36, without their power of t.
+ * dx -- The rates of x, or NULL.
+ * lbr -- The longitude & latitude in arcseconds and the distance in KM.
+ * dlbr -- The rates of lbr per Julian century if dx is not NULL.
+ */
+static void reduce_file_sums(double t, const double *x, const double *dx,
+		double *lbr, double *dlbr)
 {
-	/* Rotation matrix specified in the theory */
-	static double rot_matrix[3][3] = {
-		{ 1.000000000000, 0.000000437913, -0.000000189859},
-		{-0.000000477299, 0.917482137607, -0.397776981701},
-		{ 0.000000000000, 0.397776981701,  0.917482137607}
-	};
+	int i;
+	double y,dy,lbr1[3],lbr2[3],lbr3[3],dlbr1[3],dlbr2[3],dlbr3[3];
+
+	/* Main problem, files elp1 to elp3 */
+	for (i = 0; i < 3; i++) {
+		lbr1[i] = x[i + 1];
+		dlbr1[i] = dx ? dx[i + 1] : 0;
+	}
+
+	/* 
+	 * Perturbations: Earth (elp4-elp9), tidal effects (elp22-elp27),
+	 * Moon (elp28-elp30), relativistic (elp31-elp33), planetary effects
+	 * on solar eccentricity (elp34-elp36). The sums of each file are
+	 * multiplied by their power of t.
+	 */
+	memset(lbr2, 0, sizeof(lbr2));
+	memset(dlbr2, 0, sizeof(dlbr2));
+	for (i = 4; i <= 36; i++) {
+		if (i >= 10 && i <= 21)
+			continue;
+
+		y = x[i];
+		dy = dx ? dx[i] : 0;
+		if (file_power(i) == 1) {
+			dy = y + dy * t;
+			y *= t;
+		} else if (file_power(i) == 2) {
+			dy = (2 * y + dy * t) * t;
+			y = (y * t) * t;
+		}
+		lbr2[(i - 1) % 3] += y;
+		dlbr2[(i - 1) % 3] += dy;
+	}
+
+	/* Planetary perturbations, files elp10 to elp21 */
+	memset(lbr3, 0, sizeof(lbr3));
+	memset(dlbr3, 0, sizeof(dlbr3));
+	for (i = 10; i <= 21; i++) {
+		y = x[i];
+		dy = dx ? dx[i] : 0;
+		if (file_power(i)) {
+			dy = y + dy * t;
+			y *= t;
+		}
+		lbr3[(i - 1) % 3] += y;
+		dlbr3[(i - 1) % 3] += dy;
+	}
+
+	/* Sum up the individual contributions */
+	for (i = 0; i < 3; i++) {
+		lbr[i] = lbr1[i] + lbr2[i] + lbr3[i];
+		if (dx)
+			dlbr[i] = dlbr1[i] + dlbr2[i] + dlbr3[i];
+	}
+}
 
-	rotate_rectangular(rot_matrix, pos);
+/*
+ * Sums up the leading terms of every file of the theory for one epoch, and
+ * optionally their rates. Each file is summed up in chunks of ELP_CHUNK
+ * terms, which are then added up in order, as the worker pool does.
+ *
+ * t -- Julian centuries from J2000.
+ * arg -- The arguments of the theory.
+ * rate -- The rates of the arguments per Julian century, or NULL if the
+ *         rates of the sums are not needed.
+ * files -- The packed files, 1 to 36.
+ * count -- The number of terms to be summed up in each file, 1 to 36.
+ * lbr -- The longitude & latitude in arcseconds and the distance in KM.
+ * dlbr -- The rates of lbr per Julian century if rate is not NULL.
+ */
+static void file_sums(double t, const double *arg, const double *rate,
+		const struct packed_file *files, const int *count, double *lbr,
+		double *dlbr)
+{
+	int i,j,n;
+	double d,x[37],dx[37],r[FAST_LAYOUTS][FAST_MAX_ARGUMENTS];
+	struct harmonic_table tab[ELP_W];
+	const struct harmonic_table *h[FAST_LAYOUTS][FAST_MAX_ARGUMENTS];
+	const signed char *m;
+
+	argument_tables(arg, rate, tab, h, r);
+
+	for (i = 1; i <= 36; i++) {
+		x[i] = 0;
+		dx[i] = 0;
+		m = files[i].m;
+		for (j = 0; j < count[i]; j += ELP_CHUNK) {
+			n = count[i] - j < ELP_CHUNK ? count[i] - j : ELP_CHUNK;
+			d = 0;
+			x[i] += chunk_sum(files, i, j, n, &m, h,
+				rate ? r : NULL, &d);
+			dx[i] += d;
+		}
+	}
+
+	reduce_file_sums(t, x, rate ? dx : NULL, lbr, dlbr);
+}
+
+/*
+ * Sums up a thread's share of the chunks of the theory for the call in
+ * progress in the worker pool.
+ *
+ * k -- The thread, 0 for the caller.
+ */
+static void pool_run(int k)
+{
+	int c;
+	const signed char *m;
+	const struct elp_chunk *ch;
+
+	for (c = pool.first[k]; c < pool.first[k + 1]; c++) {
+		ch = &pool.chunks[c];
+		m = ch->m;
+		pool.partial[c] = chunk_sum(packed_files, ch->file, ch->start,
+			ch->count, &m, pool.h, NULL, NULL);
+	}
+}
+
+/*
+ * The routine of a thread of the worker pool, which waits for a call, sums
+ * up its share of the chunks and reports back until the pool is stopped.
+ *
+ * arg -- The thread, from 1 to the number of threads - 1.
+ *
+ * Return: NULL.
+ */
+static void *pool_worker(void *arg)
+{
+	int k = (int)(intptr_t)arg;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		while (pool.generation == seen && !pool.quit)
+			pthread_cond_wait(&pool_start, &pool_lock);
+		if (pool.quit)
+			break;
+
+		seen = pool.generation;
+		pthread_mutex_unlock(&pool_lock);
+		pool_run(k);
+		pthread_mutex_lock(&pool_lock);
+		if (--pool.pending == 0)
+			pthread_cond_signal(&pool_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	return NULL;
+}
+
+/*
+ * Stops the threads of the worker pool. Must be called with pool_call_lock
+ * held.
+ */
+static void stop_pool(void)
+{
+	int k;
+
+	pthread_mutex_lock(&pool_lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool_start);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (k = 1; k < pool.threads; k++)
+		pthread_join(pool.tid[k], NULL);
+
+	pool.quit = 0;
+	pool.threads = 1;
+}
+
+/*
+ * Cuts the theory into chunks of ELP_CHUNK terms, in the order in which
+ * file_sums() sums them up, and shares them out between the threads of the
+ * worker pool by the size of their multipliers, which tracks their cost.
+ * Must be called with pool_call_lock held.
+ *
+ * threads -- The number of threads, the caller included.
+ *
+ * Return: 1 -- If the chunks have been shared out.
+ *         0 -- If memory could not be allocated.
+ */
+static int share_chunks(int threads)
+{
+	int i,j,k,c,n;
+	long size,total;
+	const signed char *m;
+	const struct packed_file *files = get_packed_files();
+
+	if (!pool.chunks) {
+		n = 0;
+		for (i = 1; i <= 36; i++)
+			n += (elp_file_count[i] + ELP_CHUNK - 1) / ELP_CHUNK;
+
+		pool.chunks = malloc(n * sizeof(*pool.chunks));
+		pool.partial = malloc(n * sizeof(*pool.partial));
+		if (!pool.chunks || !pool.partial) {
+			free(pool.chunks);
+			free(pool.partial);
+			pool.chunks = NULL;
+			pool.partial = NULL;
+			return 0;
+		}
+
+		c = 0;
+		for (i = 1; i <= 36; i++) {
+			m = files[i].m;
+			for (j = 0; j < elp_file_count[i]; j += ELP_CHUNK) {
+				n = elp_file_count[i] - j;
+				pool.chunks[c].file = i;
+				pool.chunks[c].start = j;
+				pool.chunks[c].count = n < ELP_CHUNK ? n : ELP_CHUNK;
+				pool.chunks[c].m = m;
+				for (n = pool.chunks[c].count; n > 0; n--)
+					m += 1 + 2 * m[0];
+				pool.chunks[c].size = m - pool.chunks[c].m;
+				c++;
+			}
+		}
+		pool.chunk_count = c;
+	}
+
+	total = 0;
+	for (c = 0; c < pool.chunk_count; c++)
+		total += pool.chunks[c].size;
+
+	/* Thread k takes the chunks up to (k + 1) / threads of the total */
+	size = 0;
+	k = 0;
+	pool.first[0] = 0;
+	for (c = 0; c < pool.chunk_count; c++) {
+		size += pool.chunks[c].size;
+		while (k < threads - 1 && size * threads >= (k + 1) * total)
+			pool.first[++k] = c + 1;
+	}
+	while (k < threads)
+		pool.first[++k] = pool.chunk_count;
+
+	return 1;
+}
+
+/*
+ * Sums up the series of the theory for one epoch with the worker pool. The
+ * chunks are added up in the same order as file_sums() does, so the sums
+ * are the same to the bit.
+ *
+ * t -- The epoch in Julian centuries from J2000.
+ * arg -- The arguments of the theory.
+ * lbr -- The sums for the longitude & latitude in arcseconds and the
+ *        distance in KM.
+ *
+ * Return: 1 -- If the series have been summed up.
+ *         0 -- If the pool is not running or busy with another call.
+ */
+static int pool_sums(double t, const double *arg, double *lbr)
+{
+	int i,c;
+	double x[37],r[FAST_LAYOUTS][FAST_MAX_ARGUMENTS];
+	struct harmonic_table tab[ELP_W];
+	const struct harmonic_table *h[FAST_LAYOUTS][FAST_MAX_ARGUMENTS];
+
+	if (pthread_mutex_trylock(&pool_call_lock))
+		return 0;
+	if (pool.threads < 2) {
+		pthread_mutex_unlock(&pool_call_lock);
+		return 0;
+	}
+
+	argument_tables(arg, NULL, tab, h, r);
+
+	pthread_mutex_lock(&pool_lock);
+	pool.h = h;
+	pool.pending = pool.threads - 1;
+	pool.generation++;
+	pthread_cond_broadcast(&pool_start);
+	pthread_mutex_unlock(&pool_lock);
+
+	pool_run(0);
+
+	pthread_mutex_lock(&pool_lock);
+	while (pool.pending)
+		pthread_cond_wait(&pool_done, &pool_lock);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (i = 1; i <= 36; i++)
+		x[i] = 0;
+	for (c = 0; c < pool.chunk_count; c++)
+		x[pool.chunks[c].file] += pool.partial[c];
+	pthread_mutex_unlock(&pool_call_lock);
+
+	reduce_file_sums(t, x, NULL, lbr, NULL);
+	return 1;
+}
+
+/*
+ * Sums up the series of the theory for one epoch.
+ *
+ * t -- The epoch in Julian centuries from J2000.
+ * arg -- The arguments of the theory.
+ * lbr -- The sums for the longitude & latitude in arcseconds and the
+ *        distance in KM.
+ */
+static void elp_sums(double t, const double *arg, double *lbr)
+{
+#ifdef KEPLER_GENERATED
+	if (current_kernel == VSOP87_KERNEL_GENERATED) {
+		generated_moon(arg, t, lbr);
+		return;
+	}
+#endif
+
+	if (__atomic_load_n(&pool.threads, __ATOMIC_RELAXED) > 1 &&
+		pool_sums(t, arg, lbr))
+		return;
+
+	file_sums(t, arg, NULL, get_packed_files(), elp_file_count, lbr, NULL);
+}
+
+/*
+ * Sets up the worker pool that elp82b_coordinates() shares the theory with,
+ * for the lowest latency of a single position. The main problem, the
+ * perturbations and the chunks of the largest files of the planetary
+ * perturbations are summed up by the threads of the pool and the caller,
+ * and their sums added up in a fixed order, so the positions are the same
+ * to the bit as without the pool. The threads wait for calls without
+ * spinning. The pool is not used by the other functions of the theory.
+ *
+ * threads -- The number of threads summing up a call, the caller included,
+ *            up to ELP82B_MAX_THREADS. 0 or 1 stops the pool.
+ *
+ * Return: SUCCESS -- If the pool has been set up.
+ *         ERR_UNSUPPORTED -- If threads is more than ELP82B_MAX_THREADS, or
+ *                            the threads or their memory could not be had.
+ *                            The pool is then stopped.
+ */
+int elp82b_set_threads(unsigned int threads)
+{
+	int k;
+
+	if (threads > ELP82B_MAX_THREADS)
+		return ERR_UNSUPPORTED;
+
+	pthread_mutex_lock(&pool_call_lock);
+	stop_pool();
+	if (threads < 2) {
+		pthread_mutex_unlock(&pool_call_lock);
+		return SUCCESS;
+	}
+
+	if (!share_chunks(threads)) {
+		pthread_mutex_unlock(&pool_call_lock);
+		return ERR_UNSUPPORTED;
+	}
+
+	pool.generation = 0;
+	for (k = 1; k < (int)threads; k++) {
+		if (pthread_create(&pool.tid[k], NULL, pool_worker,
+				(void *)(intptr_t)k))
+			break;
+		pool.threads = k + 1;
+	}
+	if (pool.threads < (int)threads) {
+		stop_pool();
+		pthread_mutex_unlock(&pool_call_lock);
+		return ERR_UNSUPPORTED;
+	}
+	pthread_mutex_unlock(&pool_call_lock);
+
+	return SUCCESS;
+}
+
+/* Stops the worker pool when the library is unloaded */
+static void __attribute__((destructor)) elp82b_fini(void)
+{
+	pthread_mutex_lock(&pool_call_lock);
+	stop_pool();
+	pthread_mutex_unlock(&pool_call_lock);
+}
+
+/*
+ * Calculates the Moon's geocentric rectangular coordinates using the
+ * ELP 2000-82B lunar theory in its entirety.
+ *
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * pos -- The Moon's geocentric rectangular coordinates in KM. The reference
+ *        frame is the equinox & ecliptic of J2000.
+ */
+void elp82b_coordinates(struct julian_date *tdb, struct rectangular_coordinates *pos)
+{
+	double t,lbr[3],arg[ELP_ARGUMENTS];
+
+	t = JULIAN_CENTURIES(tdb->date1, tdb->date2);
+	elp_arguments(tdb, arg);
+	elp_sums(t, arg, lbr);
+	elp_to_rectangular(t, arg[ELP_W], lbr, ELP82B_FRAME_ECLIPTIC, pos);
+}
+
+/*
+ * Calculates the Moon's geocentric position and velocity using the
+ * ELP 2000-82B lunar theory in its entirety. The velocity is the analytic
+ * derivative of the theory, including the files multiplied by t and the
+ * precession of the ecliptic of date, and the series are differentiated in
+ * the same pass over the terms as they are summed up. The position is the
+ * same as from elp82b_coordinates(), except with VSOP87_KERNEL_GENERATED.
+ *
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * pos -- The Moon's geocentric rectangular coordinates in KM. The reference
+ *        frame is the equinox & ecliptic of J2000.
+ * vel -- The Moon's geocentric velocity in KM/day, in the same frame.
+ */
+void elp82b_state(struct julian_date *tdb, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	int i;
+	double t,U,V,r,dU,dV,dr,sU,cU,sV,cV,e[3],de[3],v[3],pm[3][3],dpm[3][3],
+		lbr[3],dlbr[3],arg[ELP_ARGUMENTS],rate[ELP_ARGUMENTS];
+
+	t = JULIAN_CENTURIES(tdb->date1, tdb->date2);
+	elp_arguments(tdb, arg);
+	elp_argument_rates(t, rate);
+	file_sums(t, arg, rate, get_packed_files(), elp_file_count, lbr,
+		dlbr);
+	elp_to_rectangular(t, arg[ELP_W], lbr, ELP82B_FRAME_ECLIPTIC, pos);
+
+	/* Differentiate the spherical coordinates of the ecliptic of date */
+	V = arg[ELP_W] + lbr[0] * ACS_TO_RAD;
+	U = lbr[1] * ACS_TO_RAD;
+	r = lbr[2] * 384747.9806448954 / 384747.9806743165;
+	dV = rate[ELP_W] + dlbr[0] * ACS_TO_RAD;
+	dU = dlbr[1] * ACS_TO_RAD;
+	dr = dlbr[2] * 384747.9806448954 / 384747.9806743165;
+
+	sincos(V, &sV, &cV);
+	sincos(U, &sU, &cU);
+	e[0] = r * cV * cU;
+	e[1] = r * sV * cU;
+	e[2] = r * sU;
+	de[0] = dr * cV * cU - r * (sV * cU * dV + cV * sU * dU);
+	de[1] = dr * sV * cU + r * (cV * cU * dV - sV * sU * dU);
+	de[2] = dr * sU + r * cU * dU;
+
+	/* And then their rotation to the mean ecliptic of J2000 */
+	elp_precession(t, pm, dpm);
+	for (i = 0; i < 3; i++)
+		v[i] = (pm[i][0] * de[0] + pm[i][1] * de[1] + pm[i][2] * de[2] +
+			dpm[i][0] * e[0] + dpm[i][1] * e[1] + dpm[i][2] * e[2]) /
+			JULIAN_CENTURY_LENGTH;
+
+	vel->x = v[0];
+	vel->y = v[1];
+	vel->z = v[2];
+}
+
+/*
+ * Calculates the Moon's geocentric rectangular coordinates at a number of
+ * epochs using the ELP 2000-82B lunar theory in its entirety. The epochs are
+ * processed in blocks of BATCH_BLOCK_SIZE, with the lanes of the vectors of
+ * the kernel selected by elp82b_set_kernel() holding consecutive epochs, so
+ * every term of the theory is read once per block. The results differ from
+ * elp82b_coordinates() by at most ELP82B_BATCH_TOLERANCE.
+ *
+ * tdb -- Array of n TDBs to be used for calculations. TT may be used for all
+ *        but the most exacting applications.
+ * n -- The number of epochs in tdb.
+ * frame -- ELP82B_FRAME_ECLIPTIC for the equinox & ecliptic of J2000, or
+ *          ELP82B_FRAME_EQUATORIAL for the equatorial frame of J2000/FK5, as
+ *          from elp82b_ecliptic_to_equator().
+ * pos -- Array of n elements that will contain the Moon's geocentric
+ *        rectangular coordinates in KM.
+ *
+ * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ *         ERR_UNSUPPORTED -- If the frame is unknown.
+ */
+int elp82b_coordinates_batch(const struct julian_date *tdb, size_t n,
+		int frame, struct rectangular_coordinates *pos)
+{
+	int i,j,k,m,power;
+	size_t l;
+	double x,t[BATCH_BLOCK_SIZE],sum[BATCH_BLOCK_SIZE],
+		lbr[BATCH_BLOCK_SIZE][3][3],arg[BATCH_BLOCK_SIZE][ELP_ARGUMENTS],
+		barg[ELP_ARGUMENTS * BATCH_BLOCK_SIZE];
+	void (*batch)(int i, const double *arg, double *sum) = batch_sum;
+
+	if (frame != ELP82B_FRAME_ECLIPTIC && frame != ELP82B_FRAME_EQUATORIAL)
+		return ERR_UNSUPPORTED;
+
+	/* The epochs past the end of the last block are left at 0 */
+	memset(barg, 0, sizeof(barg));
+	for (l = 0; l < n; l += m) {
+		m = (n - l < BATCH_BLOCK_SIZE) ? n - l : BATCH_BLOCK_SIZE;
+		for (j = 0; j < m; j++) {
+			t[j] = JULIAN_CENTURIES(tdb[l + j].date1, tdb[l + j].date2);
+			elp_arguments(&tdb[l + j], arg[j]);
+			for (k = 0; k < ELP_ARGUMENTS; k++)
+				barg[k * BATCH_BLOCK_SIZE + j] = arg[j][k];
+		}
+
+		if (!batch) {
+			for (j = 0; j < m; j++) {
+				elp_sums(t[j], arg[j], sum);
+				elp_to_rectangular(t[j], arg[j][ELP_W], sum, frame,
+					&pos[l + j]);
+			}
+			continue;
+		}
+
+		/* As in elp_sums(), in the main problem, perturbations & planets */
+		memset(lbr, 0, sizeof(lbr));
+		for (i = 1; i <= 36; i++) {
+			batch(i, barg, sum);
+			k = (i >= 10 && i <= 21) ? 2 : (i > 3);
+			power = file_power(i);
+			for (j = 0; j < m; j++) {
+				x = sum[j];
+				if (power == 1)
+					x *= t[j];
+				else if (power == 2)
+					x = (x * t[j]) * t[j];
+				lbr[j][k][(i - 1) % 3] += x;
+			}
+		}
+
+		for (j = 0; j < m; j++) {
+			for (k = 0; k < 3; k++)
+				sum[k] = lbr[j][0][k] + lbr[j][1][k] + lbr[j][2][k];
+			elp_to_rectangular(t[j], arg[j][ELP_W], sum, frame,
+				&pos[l + j]);
+		}
+	}
+
+	return SUCCESS;
+}
+
+/*
+ * Sums up a single precision series for a block of epochs, one term at a
+ * time with sinf() from the C library.
+ *
+ * s -- The series.
+ * arg -- The arguments of the theory for each epoch, FAST_ARG_STRIDE
+ *        elements per epoch.
+ * m -- The number of epochs.
+ * sum -- The sum for each epoch.
+ */
+static void fast_sum_scalar(const struct fast_series *s, const float *arg,
+		int m, double *sum)
+{
+	int i,j,k;
+	float x,acc;
+
+	for (j = 0; j < m; j++) {
+		acc = 0;
+		for (i = 0; i < s->count; i++) {
+			x = s->phase[i];
+			for (k = 0; k < s->arg_count; k++)
+				x += s->mult[k][i] * arg[j * FAST_ARG_STRIDE + s->arg[k]];
+			acc += s->amp[i] * sinf(x);
+		}
+		sum[j] = acc;
+	}
+}
+
+/*
+ * Returns the layout of the arguments of a file of the theory.
+ *
+ * i -- The file, 1 to 36.
+ *
+ * Return: An index into layout_args.
+ */
+static int file_layout(int i)
+{
+	if (i <= 3)
+		return 0;
+	if (i >= 10 && i <= 15)
+		return 2;
+	if (i >= 16 && i <= 21)
+		return 3;
+	return 1;
+}
+
+/*
+ * Returns the power of t that multiplies the terms of a file of the theory.
+ *
+ * i -- The file, 1 to 36.
+ *
+ * Return: 0, 1 or 2.
+ */
+static int file_power(int i)
+{
+	if ((i >= 7 && i <= 9) || (i >= 13 && i <= 15) ||
+		(i >= 19 && i <= 21) || (i >= 25 && i <= 27))
+		return 1;
+	if (i >= 34)
+		return 2;
+	return 0;
+}
+
+/*
+ * Returns the single precision series that holds the terms of a file.
+ *
+ * i -- The file, 1 to 36.
+ *
+ * Return: An index into fast_series.
+ */
+static int file_series(int i)
+{
+	return (file_layout(i) * 3 + file_power(i)) * 3 + (i - 1) % 3;
+}
+
+/*
+ * Reads a term of any file of the theory.
+ *
+ * i -- The file, 1 to 36.
+ * j -- The index of the term in the file.
+ * term -- The amplitude, phase in [-PI, PI] and multipliers of the term.
+ */
+static void file_term(int i, int j, struct fast_term *term)
+{
+	const struct elp82b_term1 *p1;
+	const struct elp82b_term2 *p2;
+	const struct elp82b_term3 *p3;
+
+	memset(term, 0, sizeof(*term));
+	switch (file_layout(i)) {
+	case 0:
+		p1 = (const struct elp82b_term1 *)elp_terms[i] + j;
+		term->amp = main_amplitudes[i][j];
+		term->phase = (i == 3) ? PI / 2 : 0;
+		term->mult[0] = p1->i1;
+		term->mult[1] = p1->i2;
+		term->mult[2] = p1->i3;
+		term->mult[3] = p1->i4;
+		break;
+	case 1:
+		p2 = (const struct elp82b_term2 *)elp_terms[i] + j;
+		term->amp = p2->a;
+		term->phase = p2->phi;
+		term->mult[0] = p2->i1;
+		term->mult[1] = p2->i2;
+		term->mult[2] = p2->i3;
+		term->mult[3] = p2->i4;
+		term->mult[4] = p2->i5;
+		break;
+	default:
+		p3 = (const struct elp82b_term3 *)elp_terms[i] + j;
+		term->amp = p3->a;
+		term->phase = p3->phi;
+		term->mult[0] = p3->i1;
+		term->mult[1] = p3->i2;
+		term->mult[2] = p3->i3;
+		term->mult[3] = p3->i4;
+		term->mult[4] = p3->i5;
+		term->mult[5] = p3->i6;
+		term->mult[6] = p3->i7;
+		term->mult[7] = p3->i8;
+		term->mult[8] = p3->i9;
+		term->mult[9] = p3->i10;
+		term->mult[10] = p3->i11;
+		break;
+	}
+
+	term->phase -= TWO_PI * floor(term->phase / TWO_PI + 0.5);
+}
+
+/* Orders terms by increasing amplitude, for use with qsort() */
+static int compare_term(const void *x, const void *y)
+{
+	double a1 = fabs(((const struct fast_term *)x)->amp);
+	double a2 = fabs(((const struct fast_term *)y)->amp);
+
+	return (a1 > a2) - (a1 < a2);
+}
+
+/*
+ * Builds the single precision form of the theory.
+ *
+ * Return: 1 -- If the single precision form has been built.
+ *         0 -- If memory could not be allocated.
+ */
+static int build_fast_series(void)
+{
+	int i,j,k,n,total,count[FAST_SERIES_COUNT];
+	float *mem;
+	struct fast_term *terms;
+	struct fast_series *s;
+
+	memset(count, 0, sizeof(count));
+	for (i = 1; i <= 36; i++)
+		count[file_series(i)] += elp_term_count[i];
+
+	total = 0;
+	n = 0;
+	for (i = 0; i < FAST_SERIES_COUNT; i++) {
+		j = i / 9;
+		fast_series[i].count = (count[i] + FAST_PADDING - 1) /
+			FAST_PADDING * FAST_PADDING;
+		fast_series[i].arg_count = layout_arg_count[j];
+		fast_series[i].arg = layout_args[j];
+		total += fast_series[i].count * (2 + layout_arg_count[j]);
+		if (count[i] > n)
+			n = count[i];
+	}
+
+	mem = malloc(total * sizeof(float));
+	terms = malloc(n * sizeof(*terms));
+	if (!mem || !terms) {
+		free(mem);
+		free(terms);
+		return 0;
+	}
+
+	fast_mem = mem;
+	for (i = 0; i < FAST_SERIES_COUNT; i++) {
+		s = &fast_series[i];
+		s->amp = mem;
+		mem += s->count;
+		s->phase = mem;
+		mem += s->count;
+		for (k = 0; k < s->arg_count; k++) {
+			s->mult[k] = mem;
+			mem += s->count;
+		}
+
+		/* Gather the terms of every file of the series & sort them */
+		n = 0;
+		for (j = 1; j <= 36; j++) {
+			if (file_series(j) != i)
+				continue;
+			for (k = 0; k < elp_term_count[j]; k++)
+				file_term(j, k, &terms[n++]);
+		}
+		qsort(terms, n, sizeof(*terms), compare_term);
+
+		/* The padding terms have zero amplitude and come first */
+		for (j = 0; j < s->count; j++) {
+			n = j - (s->count - count[i]);
+			s->amp[j] = n >= 0 ? terms[n].amp : 0;
+			s->phase[j] = n >= 0 ? terms[n].phase : 0;
+			for (k = 0; k < s->arg_count; k++)
+				s->mult[k][j] = n >= 0 ? terms[n].mult[k] : 0;
+		}
+	}
+	free(terms);
+
+	return 1;
+}
+
+/* Orders terms by decreasing amplitude, for use with qsort() */
+static int compare_ranked(const void *x, const void *y)
+{
+	double a1 = ((const struct ranked_term *)x)->amplitude;
+	double a2 = ((const struct ranked_term *)y)->amplitude;
+
+	return (a1 < a2) - (a1 > a2);
+}
+
+/*
+ * Returns the amplitude of a term of any file of the theory.
+ *
+ * i -- The file, 1 to 36.
+ * j -- The index of the term in the file.
+ *
+ * Return: The absolute value of the amplitude.
+ */
+static double file_amplitude(int i, int j)
+{
+	switch (file_layout(i)) {
+	case 0:
+		return fabs(main_amplitudes[i][j]);
+	case 1:
+		return fabs(((const struct elp82b_term2 *)elp_terms[i])[j].a);
+	default:
+		return fabs(((const struct elp82b_term3 *)elp_terms[i])[j].a);
+	}
+}
+
+/*
+ * Copies a term of any file of the theory into a packed file. Only the
+ * multipliers that are not zero are kept, after their number, each with
+ * the index of its argument in the layout of the file. A*sin(x + phi) is
+ * summed up as A*cos(phi)*sin(x) + A*sin(phi)*cos(x).
+ *
+ * i -- The file, 1 to 36.
+ * j -- The index of the term in the file.
+ * k -- The index of the term in the packed file.
+ * m -- Where the multipliers of the term are to be stored.
+ * a -- The amplitudes, or A*cos(phi), of the packed file.
+ * b -- A*sin(phi) of the packed file, unless i is in the main problem.
+ *
+ * Return: The end of the multipliers of the term.
+ */
+static signed char *pack_term(int i, int j, int k, signed char *m,
+		double *a, double *b)
+{
+	int l,n;
+	signed char *count;
+	const short *im;
+	const struct elp82b_term1 *p1;
+	const struct elp82b_term2 *p2;
+	const struct elp82b_term3 *p3;
+
+	switch (file_layout(i)) {
+	case 0:
+		p1 = (const struct elp82b_term1 *)elp_terms[i] + j;
+		im = &p1->i1;
+		a[k] = main_amplitudes[i][j];
+		break;
+	case 1:
+		p2 = (const struct elp82b_term2 *)elp_terms[i] + j;
+		im = &p2->i1;
+		a[k] = p2->a * cos(p2->phi);
+		b[k] = p2->a * sin(p2->phi);
+		break;
+	default:
+		p3 = (const struct elp82b_term3 *)elp_terms[i] + j;
+		im = &p3->i1;
+		a[k] = p3->a * cos(p3->phi);
+		b[k] = p3->a * sin(p3->phi);
+		break;
+	}
+
+	count = m++;
+	*count = 0;
+	n = layout_arg_count[file_layout(i)];
+	for (l = 0; l < n; l++) {
+		if (im[l]) {
+			*m++ = l;
+			*m++ = im[l];
+			(*count)++;
+		}
+	}
+
+	return m;
+}
+
+/*
+ * Builds the packed files of the theory in the storage of elp82b_data.c,
+ * with the terms of each file in order of decreasing amplitude. If memory
+ * to sort them could not be allocated, they are left in their order in the
+ * files and packed_sorted is cleared.
+ */
+static void build_packed_files(void)
+{
+	int i,j,k,n;
+	signed char *m;
+	double *a,*tail;
+	struct ranked_term *ranked;
+	struct packed_file *f;
+
+	n = 0;
+	for (i = 1; i <= 36; i++) {
+		if (elp_term_count[i] > n)
+			n = elp_term_count[i];
+	}
+	ranked = malloc(n * sizeof(*ranked));
+	packed_sorted = ranked != NULL;
+
+	m = elp_packed_multipliers;
+	a = elp_packed_amplitudes;
+	tail = elp_packed_tails;
+	for (i = 1; i <= 36; i++) {
+		n = elp_term_count[i];
+		if (ranked) {
+			for (j = 0; j < n; j++) {
+				ranked[j].amplitude = file_amplitude(i, j);
+				ranked[j].index = j;
+			}
+			qsort(ranked, n, sizeof(*ranked), compare_ranked);
+		}
+
+		f = &packed_files[i];
+		f->m = m;
+		f->a = a;
+		f->b = file_layout(i) ? a + n : NULL;
+		f->tail = tail;
+
+		for (j = 0; j < n; j++) {
+			k = ranked ? ranked[j].index : j;
+			m = pack_term(i, k, j, m, a, file_layout(i) ? a + n : NULL);
+		}
+
+		tail[n] = 0;
+		for (j = n - 1; j >= 0; j--) {
+			k = ranked ? ranked[j].index : j;
+			tail[j] = tail[j + 1] + file_amplitude(i, k);
+		}
+
+		a += file_layout(i) ? 2 * n : n;
+		tail += n + 1;
+	}
+	free(ranked);
+}
+
+/*
+ * Returns the packed files of the theory, building them on first use.
+ *
+ * Return: The packed files, 1 to 36.
+ */
+static const struct packed_file *get_packed_files(void)
+{
+	if (!__atomic_load_n(&packed_ready, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_lock(&tol_lock);
+		if (!packed_ready) {
+			build_packed_files();
+			__atomic_store_n(&packed_ready, 1, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&tol_lock);
+	}
+
+	return packed_files;
+}
+
+/*
+ * Builds the plan for a tolerance. For each variable, the terms of all its
+ * files are ranked by their amplitude times span^k, with the distance
+ * converted to arcseconds at MOON_DISTANCE. The smallest are dropped as
+ * long as the sum of what was dropped stays within the tolerance. Since
+ * the terms of a file are ranked in the order of its packed copy, what is
+ * dropped from a file is always a tail of the copy, and whole files go when
+ * none of their terms is needed.
+ *
+ * tolerance -- The largest error in arcseconds allowed in each variable.
+ * span -- The largest |t| in Julian centuries covered by the plan.
+ * plan -- The plan.
+ *
+ * Return: 1 -- If the plan has been built.
+ *         0 -- If memory could not be allocated.
+ */
+static int build_tol_plan(double tolerance, double span,
+		struct tol_plan *plan)
+{
+	int i,j,k,n,total;
+	double scale,sum;
+	struct ranked_term *ranked;
+
+	plan->tolerance = tolerance;
+	plan->span = span;
+	total = 0;
+	for (i = 1; i <= 36; i++) {
+		plan->count[i] = elp_term_count[i];
+		total += elp_term_count[i];
+	}
+	if (!(tolerance > 0))
+		return 1;
+
+	ranked = malloc(total * sizeof(*ranked));
+	if (!ranked)
+		return 0;
+
+	for (k = 0; k < 3; k++) {
+		n = 0;
+		for (i = k + 1; i <= 36; i += 3) {
+			scale = pow(span, file_power(i));
+			if (k == 2)
+				scale /= ACS_TO_RAD * MOON_DISTANCE;
+			for (j = 0; j < elp_term_count[i]; j++) {
+				ranked[n].amplitude = packed_files[i].tail[j] -
+					packed_files[i].tail[j + 1];
+				ranked[n].amplitude *= scale;
+				ranked[n].file = i;
+				ranked[n++].index = j;
+			}
+		}
+		qsort(ranked, n, sizeof(*ranked), compare_ranked);
+
+		sum = 0;
+		for (j = n - 1; j >= 0; j--) {
+			sum += ranked[j].amplitude;
+			if (sum > tolerance)
+				break;
+			plan->count[ranked[j].file]--;
+		}
+	}
+	free(ranked);
+
+	return 1;
+}
+
+/*
+ * Looks up the plan for a tolerance and span, building it on first use. The
+ * least recently built plan makes way for a new one. The packed files must
+ * have been built.
+ *
+ * tolerance -- The largest error in arcseconds allowed in each variable.
+ * span -- The largest |t| in Julian centuries covered by the plan.
+ * count -- The number of leading terms to be summed up in each file.
+ *
+ * Return: 1 -- If the plan has been found.
+ *         0 -- If memory could not be allocated.
+ */
+static int get_tol_plan(double tolerance, double span, int *count)
+{
+	int i;
+
+	if (!packed_sorted)
+		return 0;
+
+	pthread_mutex_lock(&tol_lock);
+
+	for (i = 0; i < tol_plan_count; i++) {
+		if (tol_plans[i].tolerance == tolerance &&
+			tol_plans[i].span == span)
+			break;
+	}
+	if (i == tol_plan_count) {
+		i = tol_plan_next;
+		if (!build_tol_plan(tolerance, span, &tol_plans[i])) {
+			pthread_mutex_unlock(&tol_lock);
+			return 0;
+		}
+		tol_plan_next = (i + 1) % TOL_PLANS;
+		if (tol_plan_count < TOL_PLANS)
+			tol_plan_count++;
+	}
+
+	memcpy(count, tol_plans[i].count, sizeof(tol_plans[i].count));
+	pthread_mutex_unlock(&tol_lock);
+
+	return 1;
+}
+
+/*
+ * Calculates the Moon's geocentric rectangular coordinates at a number of
+ * epochs using the ELP 2000-82B lunar theory in single precision. The terms
+ * are summed up with floats, in vectors with as many lanes as the CPU
+ * supports. The epochs and the fundamental arguments are handled in double
+ * precision, and the arguments are reduced to [-PI, PI] before they are
+ * rounded to floats, so the accuracy does not degrade far from J2000. The
+ * largest difference from elp82b_coordinates() is given by
+ * ELP82B_FAST_TOLERANCE.
+ *
+ * tdb -- Array of n TDBs to be used for calculations. TT may be used for all
+ *        but the most exacting applications.
+ * n -- The number of epochs in tdb.
+ * pos -- Array of n elements that will contain the Moon's geocentric
+ *        rectangular coordinates in KM. The reference frame is the equinox &
+ *        ecliptic of J2000.
+ */
+NO_CONTRACT void elp82b_coordinates_fast(const struct julian_date *tdb,
+		size_t n, struct rectangular_coordinates *pos)
+{
+	int i,j,k,m;
+	size_t l;
+	double x,t[FAST_BLOCK_SIZE],sum[FAST_BLOCK_SIZE],lbr[FAST_BLOCK_SIZE][3],
+		arg[FAST_BLOCK_SIZE][ELP_ARGUMENTS];
+	float farg[FAST_BLOCK_SIZE * FAST_ARG_STRIDE];
+	struct julian_date jd;
+
+	if (!__atomic_load_n(&fast_ready, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_lock(&fast_lock);
+		if (!fast_ready)
+			__atomic_store_n(&fast_ready, build_fast_series() ? 1 : -1,
+					__ATOMIC_RELEASE);
+		pthread_mutex_unlock(&fast_lock);
+	}
+
+	/* Without the single precision form, use the full theory */
+	if (fast_ready < 0) {
+		for (l = 0; l < n; l++) {
+			jd = tdb[l];
+			elp82b_coordinates(&jd, &pos[l]);
+		}
+		return;
+	}
+
+	memset(farg, 0, sizeof(farg));
+	for (l = 0; l < n; l += m) {
+		m = (n - l < FAST_BLOCK_SIZE) ? n - l : FAST_BLOCK_SIZE;
+		for (j = 0; j < m; j++) {
+			t[j] = JULIAN_CENTURIES(tdb[l + j].date1, tdb[l + j].date2);
+			elp_arguments(&tdb[l + j], arg[j]);
+			for (k = 0; k < ELP_W; k++)
+				farg[j * FAST_ARG_STRIDE + k] = arg[j][k];
+		}
+
+		/* Series i is for variable i % 3 and power (i / 3) % 3 of t */
+		memset(lbr, 0, sizeof(lbr));
+		for (i = 0; i < FAST_SERIES_COUNT; i++) {
+			if (!fast_series[i].count)
+				continue;
+
+			fast_sum(&fast_series[i], farg, m, sum);
+			for (j = 0; j < m; j++) {
+				x = sum[j];
+				for (k = (i / 3) % 3; k > 0; k--)
+					x *= t[j];
+				lbr[j][i % 3] += x;
+			}
+		}
+
+		for (j = 0; j < m; j++)
+			elp_to_rectangular(t[j], arg[j][ELP_W], lbr[j],
+				ELP82B_FRAME_ECLIPTIC, &pos[l + j]);
+	}
+}
+
+/*
+ * Calculates the Moon's geocentric rectangular coordinates using a
+ * truncated form of the ELP 2000-82B lunar theory. The terms of each file
+ * are summed in order of decreasing amplitude, and the smallest terms of
+ * each variable are dropped, across all of its files, as long as the sum of
+ * their amplitudes times |t|^k stays within the tolerance. Files with no
+ * terms left are skipped. The choice of terms is worked out once for each
+ * tolerance and reused for every epoch within the same power of 2 of
+ * centuries from J2000, taking the largest |t| in it.
+ *
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * tolerance -- The largest error in arcseconds that is acceptable in each of
+ *              the longitude, the latitude and the distance. An error in
+ *              the distance is taken in KM as the angle it subtends at the
+ *              mean distance of the Moon, so 1 arcsecond is about 1.87 KM.
+ * pos -- The Moon's geocentric rectangular coordinates in KM. The reference
+ *        frame is the equinox & ecliptic of J2000.
+ * bound -- If not NULL, the bound on the error in arcseconds that was
+ *          achieved. It is the largest over the three variables of the sum
+ *          of the dropped amplitudes times |t|^k, and is never more than
+ *          tolerance.
+ *
+ * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated.
+ */
+int elp82b_coordinates_tol(struct julian_date *tdb, double tolerance,
+		struct rectangular_coordinates *pos, double *bound)
+{
+	int i,count[37];
+	double t,span,err[3],lbr[3],arg[ELP_ARGUMENTS];
+
+	/* The plans for epochs within a century of J2000 are all the same */
+	t = JULIAN_CENTURIES(tdb->date1, tdb->date2);
+	for (span = 1; span < fabs(t); span *= 2)
+		;
+
+	get_packed_files();
+	if (!get_tol_plan(tolerance, span, count))
+		return ERR_UNSUPPORTED;
+
+	elp_arguments(tdb, arg);
+	file_sums(t, arg, NULL, packed_files, count, lbr, NULL);
+	elp_to_rectangular(t, arg[ELP_W], lbr, ELP82B_FRAME_ECLIPTIC, pos);
+
+	if (bound) {
+		memset(err, 0, sizeof(err));
+		for (i = 1; i <= 36; i++)
+			err[(i - 1) % 3] += packed_files[i].tail[count[i]] *
+				pow(fabs(t), file_power(i));
+		err[2] /= ACS_TO_RAD * MOON_DISTANCE;
+		*bound = fmax(err[0], fmax(err[1], err[2]));
+	}
+
+	return SUCCESS;
+}
+
+/*
+ * Rotates the Moon's coordinates from the ecliptic frame of J2000 to the
+ * equatorial frame of J2000/FK5.
+ *
+ * pos -- The coordinates to be rotated in-place
+ */
+void elp82b_ecliptic_to_equator(struct rectangular_coordinates *pos)
+{
+	rotate_rectangular(elp_equator_matrix, pos);
 }
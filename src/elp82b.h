@@ -19,8 +19,30 @@
 #ifndef _ELP82B_H_
 #define _ELP82B_H_
 
+#include <stddef.h>
 #include <julian_date.h>
 #include <coordinates.h>
+#include <vsop87.h>
+
+/*
+ * Largest difference in KM between elp82b_coordinates_fast() and
+ * elp82b_coordinates() within 4000 years of J2000. The largest difference
+ * found is 0.023 KM, or 0.012 arcseconds as seen from the Earth.
+ */
+#define ELP82B_FAST_TOLERANCE	0.05
+
+/*
+ * Largest difference in KM between elp82b_coordinates_batch() and
+ * elp82b_coordinates() within 4000 years of J2000.
+ */
+#define ELP82B_BATCH_TOLERANCE	1E-8
+
+/* Largest number of threads for elp82b_set_threads() */
+#define ELP82B_MAX_THREADS	8
+
+/* Frames for elp82b_coordinates_batch() */
+#define ELP82B_FRAME_ECLIPTIC	0	/* Equinox & ecliptic of J2000 */
+#define ELP82B_FRAME_EQUATORIAL	1	/* Equator of J2000/FK5 */
 
 /* Used internally to store the series of terms in the theory */
 struct elp82b_term1 {
@@ -66,6 +88,24 @@ struct elp82b_term3 {
 
 void elp82b_coordinates(struct julian_date *tdb, struct rectangular_coordinates *pos);
 
+void elp82b_coordinates_fast(const struct julian_date *tdb, size_t n,
+		struct rectangular_coordinates *pos);
+
+void elp82b_state(struct julian_date *tdb, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel);
+
+int elp82b_coordinates_tol(struct julian_date *tdb, double tolerance,
+		struct rectangular_coordinates *pos, double *bound);
+
+int elp82b_coordinates_batch(const struct julian_date *tdb, size_t n,
+		int frame, struct rectangular_coordinates *pos);
+
+int elp82b_set_kernel(enum vsop87_kernel kernel);
+
+int elp82b_set_threads(unsigned int threads);
+
+enum vsop87_kernel elp82b_get_kernel(void);
+
 void elp82b_ecliptic_to_equator(struct rectangular_coordinates *pos);
 
 #endif
@@ -38115,3 +38115,59 @@ u_short elp_term_count[] = {
 	sizeof(elp36) / sizeof(elp36[0]) - 1
 };
 
+/*
+ * Storage for the amplitudes of the main problem, files elp1 to elp3, with
+ * the corrections that elp82b.c works out when the library is loaded. The
+ * terms above are left as published.
+ */
+double elp_main_amplitudes[sizeof(elp1) / sizeof(elp1[0]) +
+	sizeof(elp2) / sizeof(elp2[0]) + sizeof(elp3) / sizeof(elp3[0])];
+
+/*
+ * Storage for the packed form of the files that elp82b.c builds on first
+ * use, in addition to the files above. ELP_ENTRIES is the number of terms
+ * plus the end marker of each file, and a term takes at most 23 bytes of
+ * multipliers: a count and 11 pairs. The multipliers only fill about a
+ * third of their share, and the pages that are never written take no
+ * memory.
+ */
+#define ELP_ENTRIES	(sizeof(elp1) / sizeof(elp1[0]) + \
+	sizeof(elp2) / sizeof(elp2[0]) + \
+	sizeof(elp3) / sizeof(elp3[0]) + \
+	sizeof(elp4) / sizeof(elp4[0]) + \
+	sizeof(elp5) / sizeof(elp5[0]) + \
+	sizeof(elp6) / sizeof(elp6[0]) + \
+	sizeof(elp7) / sizeof(elp7[0]) + \
+	sizeof(elp8) / sizeof(elp8[0]) + \
+	sizeof(elp9) / sizeof(elp9[0]) + \
+	sizeof(elp10) / sizeof(elp10[0]) + \
+	sizeof(elp11) / sizeof(elp11[0]) + \
+	sizeof(elp12) / sizeof(elp12[0]) + \
+	sizeof(elp13) / sizeof(elp13[0]) + \
+	sizeof(elp14) / sizeof(elp14[0]) + \
+	sizeof(elp15) / sizeof(elp15[0]) + \
+	sizeof(elp16) / sizeof(elp16[0]) + \
+	sizeof(elp17) / sizeof(elp17[0]) + \
+	sizeof(elp18) / sizeof(elp18[0]) + \
+	sizeof(elp19) / sizeof(elp19[0]) + \
+	sizeof(elp20) / sizeof(elp20[0]) + \
+	sizeof(elp21) / sizeof(elp21[0]) + \
+	sizeof(elp22) / sizeof(elp22[0]) + \
+	sizeof(elp23) / sizeof(elp23[0]) + \
+	sizeof(elp24) / sizeof(elp24[0]) + \
+	sizeof(elp25) / sizeof(elp25[0]) + \
+	sizeof(elp26) / sizeof(elp26[0]) + \
+	sizeof(elp27) / sizeof(elp27[0]) + \
+	sizeof(elp28) / sizeof(elp28[0]) + \
+	sizeof(elp29) / sizeof(elp29[0]) + \
+	sizeof(elp30) / sizeof(elp30[0]) + \
+	sizeof(elp31) / sizeof(elp31[0]) + \
+	sizeof(elp32) / sizeof(elp32[0]) + \
+	sizeof(elp33) / sizeof(elp33[0]) + \
+	sizeof(elp34) / sizeof(elp34[0]) + \
+	sizeof(elp35) / sizeof(elp35[0]) + \
+	sizeof(elp36) / sizeof(elp36[0]))
+
+signed char elp_packed_multipliers[23 * ELP_ENTRIES];
+double elp_packed_amplitudes[2 * ELP_ENTRIES];
+double elp_packed_tails[ELP_ENTRIES];
@@ -0,0 +1,298 @@
+/*
+ * elp82b_kernel.h - Vectorized summation for ELP 2000-82B
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file is not a regular header. elp82b.c includes it once for every
+ * instruction set it supports, after defining the following macros:
+ *
+ * KERNEL_SUFFIX -- Appended to the name of every function defined here.
+ * KERNEL_TARGET -- Instruction set string passed to the GCC target attribute.
+ *                  If it is not defined, the functions are compiled for any
+ *                  CPU, without contracting a*b + c into fused multiply-adds,
+ *                  so that every lane is rounded the same way everywhere.
+ *                  They are also marked unused, as the includer may not
+ *                  need them all.
+ * KERNEL_WIDTH  -- Number of floats in a vector register.
+ *
+ * The double precision kernels use vectors of the same size, holding half
+ * as many doubles.
+ *
+ * The macros are undefined again at the end of the file.
+ */
+
+#ifndef KERNEL_ROUND_MAGIC_F
+
+/* Adding 1.5*2^23 rounds a float to the nearest integer */
+#define KERNEL_ROUND_MAGIC_F	12582912.0f
+#define KERNEL_2_OVER_PI_F	0.636619772367581343076f
+
+/* PI/2 split into three parts (from Cephes), exact for |x| < 8192 */
+#define KERNEL_PIO2_1F		1.5703125f
+#define KERNEL_PIO2_2F		4.837512969970703125E-4f
+#define KERNEL_PIO2_3F		7.54978995489188216E-8f
+
+/* Adding 1.5*2^52 rounds a double to the nearest integer */
+#define KERNEL_ROUND_MAGIC	6755399441055744.0
+#define KERNEL_2_OVER_PI	0.636619772367581343076
+
+/* PI/2 split into three parts of 33 bits each (from fdlibm) */
+#define KERNEL_PIO2_1		1.57079632673412561417E+00
+#define KERNEL_PIO2_2		6.07710050630396597660E-11
+#define KERNEL_PIO2_3		2.02226624871116645580E-21
+
+#endif
+
+#define KERNEL_CAT2(a, b)	a##_##b
+#define KERNEL_CAT(a, b)	KERNEL_CAT2(a, b)
+#define KERNEL(name)		KERNEL_CAT(name, KERNEL_SUFFIX)
+#ifdef KERNEL_TARGET
+#define KERNEL_ATTR		__attribute__((target(KERNEL_TARGET)))
+#else
+#define KERNEL_ATTR		__attribute__((optimize("fp-contract=off"), unused))
+#endif
+
+typedef float KERNEL(vfloat) __attribute__((vector_size(4 * KERNEL_WIDTH)));
+typedef int KERNEL(vint) __attribute__((vector_size(4 * KERNEL_WIDTH)));
+typedef double KERNEL(vdouble) __attribute__((vector_size(4 * KERNEL_WIDTH)));
+typedef long long KERNEL(vlong) __attribute__((vector_size(4 * KERNEL_WIDTH)));
+
+/* Number of vectors of doubles that hold a block of epochs */
+#define KERNEL_BATCH_VECTORS	(BATCH_BLOCK_SIZE * 2 / KERNEL_WIDTH)
+
+/*
+ * Vector version of sinf(). The argument is reduced to [-PI/4, PI/4] with a
+ * three part Cody-Waite reduction by PI/2 and passed to the minimax
+ * polynomials for sinf() and cosf() from the Cephes library. The absolute
+ * error is below 1E-7 for the arguments of the theory, which are built from
+ * fundamental arguments already reduced to [-PI, PI].
+ *
+ * x -- The arguments in radians.
+ *
+ * Return: The sines of the arguments.
+ */
+static __inline__ KERNEL_ATTR KERNEL(vfloat) KERNEL(vsinf)(KERNEL(vfloat) x)
+{
+	KERNEL(vfloat) k,r,r2,s,c;
+	KERNEL(vint) q,swap,sign;
+
+	k = x * KERNEL_2_OVER_PI_F + KERNEL_ROUND_MAGIC_F;
+	q = (KERNEL(vint))k;
+	k = k - KERNEL_ROUND_MAGIC_F;
+
+	r = ((x - k * KERNEL_PIO2_1F) - k * KERNEL_PIO2_2F) - k * KERNEL_PIO2_3F;
+	r2 = r * r;
+
+	s = r + r * r2 * ((-1.9515295891E-4f * r2 + 8.3321608736E-3f) * r2 +
+		-1.6666654611E-1f);
+
+	c = 1.0f - 0.5f * r2 + r2 * r2 * ((2.443315711809948E-5f * r2 +
+		-1.388731625493765E-3f) * r2 + 4.166664568298827E-2f);
+
+	/*
+	 * sin(r + q*PI/2) is sin(r), cos(r), -sin(r), -cos(r) for q = 0..3.
+	 * swap picks cos(r) for odd q, and sign flips the result for the
+	 * quadrants where it is negative.
+	 */
+	swap = -(q & 1);
+	sign = (q & 2) << 30;
+
+	return (KERNEL(vfloat))((((KERNEL(vint))c & swap) |
+		((KERNEL(vint))s & ~swap)) ^ sign);
+}
+
+/*
+ * Sums up a single precision series of terms A*sin(phi + m1*a1 + ...) for
+ * a block of epochs. KERNEL_WIDTH terms are evaluated at once, and each
+ * group of terms is applied to every epoch in the block before moving on to
+ * the next. The lanes are added up in double precision.
+ *
+ * s -- The series, padded to a multiple of KERNEL_WIDTH terms.
+ * arg -- The arguments of the theory for each epoch, FAST_ARG_STRIDE
+ *        elements per epoch.
+ * m -- The number of epochs. At most FAST_BLOCK_SIZE.
+ * sum -- The sum for each epoch.
+ */
+static KERNEL_ATTR void KERNEL(fast_sum)(const struct fast_series *s,
+		const float *arg, int m, double *sum)
+{
+	int i,j,k,l;
+	KERNEL(vfloat) a,p,x,mult[FAST_MAX_ARGUMENTS],acc[FAST_BLOCK_SIZE];
+
+	for (j = 0; j < m; j++)
+		acc[j] = (KERNEL(vfloat)){0};
+
+	for (i = 0; i < s->count; i += KERNEL_WIDTH) {
+		memcpy(&a, s->amp + i, sizeof(a));
+		memcpy(&p, s->phase + i, sizeof(p));
+		for (k = 0; k < s->arg_count; k++)
+			memcpy(&mult[k], s->mult[k] + i, sizeof(mult[k]));
+
+		for (j = 0; j < m; j++) {
+			x = p;
+			for (k = 0; k < s->arg_count; k++)
+				x += mult[k] * arg[j * FAST_ARG_STRIDE + s->arg[k]];
+			acc[j] += a * KERNEL(vsinf)(x);
+		}
+	}
+
+	for (j = 0; j < m; j++) {
+		sum[j] = 0;
+		for (l = 0; l < KERNEL_WIDTH; l++)
+			sum[j] += acc[j][l];
+	}
+}
+
+/*
+ * Vector version of sincos(), as in vsop87_kernel.h. The argument is reduced
+ * to [-PI/4, PI/4] with a three part Cody-Waite reduction by PI/2 and passed
+ * to the minimax polynomials for sin() and cos() from the Cephes library.
+ * The absolute error is below 1E-15 for the arguments of the theory.
+ *
+ * x -- The arguments in radians.
+ * sinx -- The sines of the arguments.
+ * cosx -- The cosines of the arguments.
+ */
+static __inline__ KERNEL_ATTR void KERNEL(vsincos)(KERNEL(vdouble) x,
+		KERNEL(vdouble) *sinx, KERNEL(vdouble) *cosx)
+{
+	KERNEL(vdouble) k,r,r2,s,c;
+	KERNEL(vlong) q,swap,sign;
+
+	k = x * KERNEL_2_OVER_PI + KERNEL_ROUND_MAGIC;
+	q = (KERNEL(vlong))k;
+	k = k - KERNEL_ROUND_MAGIC;
+
+	r = ((x - k * KERNEL_PIO2_1) - k * KERNEL_PIO2_2) - k * KERNEL_PIO2_3;
+	r2 = r * r;
+
+	s = r + r * r2 * (((((1.58962301576546568060E-10 * r2 +
+		-2.50507477628578072866E-8) * r2 +
+		2.75573136213857245213E-6) * r2 +
+		-1.98412698295895385996E-4) * r2 +
+		8.33333333332211858878E-3) * r2 +
+		-1.66666666666666307295E-1);
+
+	c = 1.0 - 0.5 * r2 + r2 * r2 * (((((-1.13585365213876817300E-11 * r2 +
+		2.08757008419747316778E-9) * r2 +
+		-2.75573141792967388112E-7) * r2 +
+		2.48015872888517045348E-5) * r2 +
+		-1.38888888888730564116E-3) * r2 +
+		4.16666666666665929218E-2);
+
+	swap = -(q & 1);
+	sign = (q & 2) << 62;
+	*sinx = (KERNEL(vdouble))((((KERNEL(vlong))c & swap) |
+		((KERNEL(vlong))s & ~swap)) ^ sign);
+	sign = ((q + 1) & 2) << 62;
+	*cosx = (KERNEL(vdouble))((((KERNEL(vlong))s & swap) |
+		((KERNEL(vlong))c & ~swap)) ^ sign);
+}
+
+/*
+ * Sums up a file of the theory in double precision for a block of epochs,
+ * without the power of t that multiplies its terms. The lanes of a vector
+ * hold consecutive epochs, so every term is read once per block. The terms
+ * of each epoch are added up in the order of the file, not in the order of
+ * decreasing amplitude of elp82b_coordinates(). The difference stays within
+ * ELP82B_BATCH_TOLERANCE.
+ *
+ * i -- The file, 1 to 36.
+ * arg -- The arguments of the theory, BATCH_BLOCK_SIZE epochs of argument 0
+ *        followed by those of argument 1 and so on.
+ * sum -- The sum for each of the BATCH_BLOCK_SIZE epochs.
+ */
+static KERNEL_ATTR void KERNEL(batch_sum)(int i, const double *arg,
+		double *sum)
+{
+	int j,k,l,a8,a9;
+	const struct elp82b_term1 *p1;
+	const struct elp82b_term2 *p2;
+	const struct elp82b_term3 *p3;
+	const double *amp;
+	KERNEL(vdouble) x,s,c,acc[KERNEL_BATCH_VECTORS],
+		v[ELP_ARGUMENTS][KERNEL_BATCH_VECTORS];
+
+	for (k = 0; k < ELP_ARGUMENTS; k++)
+		memcpy(v[k], arg + k * BATCH_BLOCK_SIZE, sizeof(v[k]));
+	for (l = 0; l < KERNEL_BATCH_VECTORS; l++)
+		acc[l] = (KERNEL(vdouble)){0};
+
+	switch (file_layout(i)) {
+	case 0:
+		p1 = elp_terms[i];
+		amp = main_amplitudes[i];
+		for (j = 0; j < elp_term_count[i]; j++, p1++) {
+			for (l = 0; l < KERNEL_BATCH_VECTORS; l++) {
+				x = (double)p1->i1 * v[ELP_D][l] +
+					(double)p1->i2 * v[ELP_LP][l] +
+					(double)p1->i3 * v[ELP_L][l] +
+					(double)p1->i4 * v[ELP_F][l];
+				KERNEL(vsincos)(x, &s, &c);
+				acc[l] += amp[j] * (i == 3 ? c : s);
+			}
+		}
+		break;
+	case 1:
+		p2 = elp_terms[i];
+		for (j = elp_term_count[i]; j > 0; j--, p2++) {
+			for (l = 0; l < KERNEL_BATCH_VECTORS; l++) {
+				x = (double)p2->i1 * v[ELP_ZETA][l] +
+					(double)p2->i2 * v[ELP_D][l] +
+					(double)p2->i3 * v[ELP_LP][l] +
+					(double)p2->i4 * v[ELP_L][l] +
+					(double)p2->i5 * v[ELP_F][l] + p2->phi;
+				KERNEL(vsincos)(x, &s, &c);
+				acc[l] += p2->a * s;
+			}
+		}
+		break;
+	default:
+		a8 = (i <= 15) ? ELP_NE : ELP_D;
+		a9 = (i <= 15) ? ELP_D : ELP_LP;
+		p3 = elp_terms[i];
+		for (j = elp_term_count[i]; j > 0; j--, p3++) {
+			for (l = 0; l < KERNEL_BATCH_VECTORS; l++) {
+				x = p3->phi + (double)p3->i1 * v[ELP_ME][l] +
+					(double)p3->i2 * v[ELP_VE][l] +
+					(double)p3->i3 * v[ELP_T][l] +
+					(double)p3->i4 * v[ELP_MA][l] +
+					(double)p3->i5 * v[ELP_JU][l] +
+					(double)p3->i6 * v[ELP_SA][l] +
+					(double)p3->i7 * v[ELP_UR][l] +
+					(double)p3->i10 * v[ELP_L][l] +
+					(double)p3->i11 * v[ELP_F][l] +
+					(double)p3->i8 * v[a8][l] +
+					(double)p3->i9 * v[a9][l];
+				KERNEL(vsincos)(x, &s, &c);
+				acc[l] += p3->a * s;
+			}
+		}
+		break;
+	}
+
+	memcpy(sum, acc, sizeof(acc));
+}
+
+#undef KERNEL_BATCH_VECTORS
+#undef KERNEL_CAT2
+#undef KERNEL_CAT
+#undef KERNEL
+#undef KERNEL_ATTR
+#undef KERNEL_SUFFIX
+#undef KERNEL_TARGET
+#undef KERNEL_WIDTH
@@ -0,0 +1,146 @@
+/*
+ * harmonic.h - Sines & cosines of integer combinations of angles
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The series of ELP 2000-82B, the IAU 2000A nutation, the aberration of Ron &
+ * Vondrak and the equation of the equinoxes are sums of terms in the sine or
+ * cosine of m1*x1 + m2*x2 + ..., where x1, x2... are a handful of
+ * fundamental arguments and m1, m2... small integers. Rather than calling
+ * sin() & cos() for every term, cos(k*x) & sin(k*x) are tabulated for every
+ * argument by the Chebyshev recurrence
+ *
+ * cos((k+1)*x) = 2*cos(x)*cos(k*x) - cos((k-1)*x)
+ * sin((k+1)*x) = 2*cos(x)*sin(k*x) - sin((k-1)*x)
+ *
+ * and the sine & cosine of each term are products of entries of the tables,
+ * as complex numbers. The error of the tables grows as k^2 times the
+ * rounding error, and stays below 1E-11 for the largest multiple in use.
+ *
+ * This is an internal header, included by the theories that use it.
+ */
+
+#ifndef _HARMONIC_H_
+#define _HARMONIC_H_
+
+#include <math.h>
+
+/* Largest multiple of an argument in the tables, 71 in ELP 2000-82B */
+#define HARMONIC_MAX_MULTIPLE	72
+
+/* cos(k*x) & sin(k*x) of an argument x, for |k| <= HARMONIC_MAX_MULTIPLE */
+struct harmonic_table {
+	double z[2 * HARMONIC_MAX_MULTIPLE + 1][2];
+};
+
+/*
+ * Tabulates the multiples of an argument.
+ *
+ * x -- The argument in radians.
+ * kmax -- The largest multiple needed, at most HARMONIC_MAX_MULTIPLE. The
+ *         rest of the table is left untouched.
+ * h -- The table.
+ */
+static __inline__ void harmonic_table(double x, int kmax,
+		struct harmonic_table *h)
+{
+	int k;
+	double c2,(*z)[2] = h->z + HARMONIC_MAX_MULTIPLE;
+
+	z[0][0] = 1;
+	z[0][1] = 0;
+	sincos(x, &z[1][1], &z[1][0]);
+	z[-1][0] = z[1][0];
+	z[-1][1] = -z[1][1];
+
+	c2 = 2 * z[1][0];
+	for (k = 2; k <= kmax; k++) {
+		z[k][0] = c2 * z[k - 1][0] - z[k - 2][0];
+		z[k][1] = c2 * z[k - 1][1] - z[k - 2][1];
+		z[-k][0] = z[k][0];
+		z[-k][1] = -z[k][1];
+	}
+}
+
+/*
+ * Calculates the sine & cosine of m[0]*x[0] + m[1]*x[1] + ... from the
+ * tables of the arguments.
+ *
+ * m -- The multipliers, each within the tabulated range of its argument.
+ * h -- The table of the argument for each multiplier.
+ * n -- The number of multipliers.
+ * sn -- The sine.
+ * cs -- The cosine.
+ */
+static __inline__ void harmonic_sincos(const short *m,
+		const struct harmonic_table *const *h, int n, double *sn,
+		double *cs)
+{
+	int j;
+	double c,s,u;
+	const double *z;
+
+	z = h[0]->z[HARMONIC_MAX_MULTIPLE + m[0]];
+	c = z[0];
+	s = z[1];
+	for (j = 1; j < n; j++) {
+		z = h[j]->z[HARMONIC_MAX_MULTIPLE + m[j]];
+		u = c * z[0] - s * z[1];
+		s = s * z[0] + c * z[1];
+		c = u;
+	}
+
+	*sn = s;
+	*cs = c;
+}
+
+/*
+ * Calculates the sine & cosine of m1*x1 + m2*x2 + ... from the tables of the
+ * arguments, given only the multipliers that are not zero. Leaving out the
+ * products with cos(0) & sin(0) does not change the result.
+ *
+ * m -- The number of multipliers that are not zero, followed by the index in
+ *      h of the argument and the multiplier for each of them.
+ * h -- The tables of the arguments.
+ * sn -- The sine.
+ * cs -- The cosine.
+ *
+ * Return: The end of m.
+ */
+static __inline__ const signed char *harmonic_sincos_sparse(
+		const signed char *m, const struct harmonic_table *const *h,
+		double *sn, double *cs)
+{
+	int j;
+	double c,s,u;
+	const double *z;
+
+	c = 1;
+	s = 0;
+	for (j = *m++; j > 0; j--, m += 2) {
+		z = h[m[0]]->z[HARMONIC_MAX_MULTIPLE + m[1]];
+		u = c * z[0] - s * z[1];
+		s = s * z[0] + c * z[1];
+		c = u;
+	}
+
+	*sn = s;
+	*cs = c;
+	return m;
+}
+
+#endif
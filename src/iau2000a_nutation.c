@@ -24,6 +24,7 @@
 #include <math.h>
 #include <kepler.h>
 #include <fund_args.h>
+#include <harmonic.h>
 #include <iau2000a_nutation.h>
 
 /* These arrays in iau2000a_data.c contain the series of terms in the model */
@@ -33,6 +34,9 @@ extern struct iau2000a_term2 iau2000a_planetary[];
 extern u_short iau2000a_lunisolar_count;
 extern u_short iau2000a_planetary_count;
 
+/* Largest multiple of a fundamental argument in the series */
+#define IAU2000A_MAX_MULTIPLE	21
+
 /*
  * Calculates the mean obliquity of the ecliptic using the IAU 2000 formula.
  *
@@ -64,30 +68,36 @@ double iau2000a_mean_obliquity(struct julian_date *tdb)
 void iau2000a_nutation(struct julian_date *tdb, double *d_psi, double *d_epsilon)
 {
 	int i;
-	double t,s_phi,cs,sn,phi[15],psi_lun,psi_pla,eps_lun,eps_pla;
+	short m[14];
+	double t,cs,sn,phi[15],psi_lun,psi_pla,eps_lun,eps_pla;
+	struct harmonic_table tab[15];
+	const struct harmonic_table *h[14];
 
 	t = JULIAN_CENTURIES(tdb->date1, tdb->date2);
 
 	/* 
 	 * Get fundamental arguments (planetary longitudes, precession,
-	 * luni-solar values). We use 1-based indices for phi to make them
-	 * consistent with the reference document.
+	 * luni-solar values) and tabulate their multiples. We use 1-based
+	 * indices for phi to make them consistent with the reference document.
 	 */
-	for (i = ARG_LONGITUDE_MERCURY; i <= ARG_LONGITUDE_NODE; i++)
+	for (i = ARG_LONGITUDE_MERCURY; i <= ARG_LONGITUDE_NODE; i++) {
 		phi[i + 1] = fundamental_argument(i, t);
+		harmonic_table(phi[i + 1], IAU2000A_MAX_MULTIPLE, &tab[i + 1]);
+		h[i] = &tab[i + 1];
+	}
 
 	psi_lun = 0;
 	eps_lun = 0;
 	/* To maximize precision,sum lunisolar terms with smallest terms first */
 	for (i = iau2000a_lunisolar_count - 1; i >= 0 ; i--) {
 
-		s_phi = iau2000a_lunisolar[i].l * phi[10] +
-			iau2000a_lunisolar[i].lp * phi[11] +
-			iau2000a_lunisolar[i].f * phi[12] +
-			iau2000a_lunisolar[i].d * phi[13] +
-			iau2000a_lunisolar[i].om * phi[14];
-
-		sincos(s_phi, &sn, &cs);
+		/* The multipliers l to om go with phi[10] to phi[14] */
+		m[0] = iau2000a_lunisolar[i].l;
+		m[1] = iau2000a_lunisolar[i].lp;
+		m[2] = iau2000a_lunisolar[i].f;
+		m[3] = iau2000a_lunisolar[i].d;
+		m[4] = iau2000a_lunisolar[i].om;
+		harmonic_sincos(m, h + 9, 5, &sn, &cs);
 
 		psi_lun += (iau2000a_lunisolar[i].ps +
 			iau2000a_lunisolar[i].psd * t) * sn +
@@ -103,22 +113,22 @@ void iau2000a_nutation(struct julian_date *tdb, double *d_psi, double *d_epsilon
 	/* Sum up planetary terms with the smallest terms first */
 	for (i = 0; i < iau2000a_planetary_count; i++) {
 
-		s_phi = iau2000a_planetary[i].mer * phi[1] +
-			iau2000a_planetary[i].ven * phi[2] +
-			iau2000a_planetary[i].ear * phi[3] +
-			iau2000a_planetary[i].mar * phi[4] +
-			iau2000a_planetary[i].jup * phi[5] +
-			iau2000a_planetary[i].sat * phi[6] +
-			iau2000a_planetary[i].ura * phi[7] +
-			iau2000a_planetary[i].nep * phi[8] +
-			iau2000a_planetary[i].gp * phi[9] +
-			iau2000a_planetary[i].l * phi[10] +
-			iau2000a_planetary[i].lp * phi[11] +
-			iau2000a_planetary[i].f * phi[12] +
-			iau2000a_planetary[i].d * phi[13] +
-			iau2000a_planetary[i].om * phi[14];
-
-		sincos(s_phi, &sn, &cs);
+		/* The multipliers mer to om go with phi[1] to phi[14] */
+		m[0] = iau2000a_planetary[i].mer;
+		m[1] = iau2000a_planetary[i].ven;
+		m[2] = iau2000a_planetary[i].ear;
+		m[3] = iau2000a_planetary[i].mar;
+		m[4] = iau2000a_planetary[i].jup;
+		m[5] = iau2000a_planetary[i].sat;
+		m[6] = iau2000a_planetary[i].ura;
+		m[7] = iau2000a_planetary[i].nep;
+		m[8] = iau2000a_planetary[i].gp;
+		m[9] = iau2000a_planetary[i].l;
+		m[10] = iau2000a_planetary[i].lp;
+		m[11] = iau2000a_planetary[i].f;
+		m[12] = iau2000a_planetary[i].d;
+		m[13] = iau2000a_planetary[i].om;
+		harmonic_sincos(m, h, 14, &sn, &cs);
 
 		psi_pla += iau2000a_planetary[i].ps * sn +
 			iau2000a_planetary[i].pcp * cs;
@@ -41,6 +41,8 @@
 #define ERR_CONVERGENCE			-4
 
 #define ERR_INVALID_DATA		-5
+#define ERR_UNSUPPORTED			-6
+#define ERR_FILE_ACCESS			-7
 
 #define PI			3.141592653589793238462643
 #define TWO_PI			(2.0*PI)
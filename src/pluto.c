@@ -174,36 +174,51 @@ double fq[106] = {
 };
 
 /*
- * Calculates the heliocentric rectangular coordinates of Pluto using an
- * analytical model developed at the Bureau des Longitudes (Pluto95). This theory
- * is valid only between Jan 01, 1700 (inclusive) and Jan 24, 2100 (exclusive).
+ * Every frequency of the Poisson terms is also one of the first
+ * PLUTO_FREQUENCY_COUNT frequencies, of the periodic terms. This is its index
+ * among them, for each Poisson term.
+ */
+static const unsigned char poisson_frequency[106 - PLUTO_FREQUENCY_COUNT] = {
+	1,3,6,7,8,12,15,17,18,21,25,31,37,57,61,70,72,75,79,
+	1,6,25,72,79
+};
+
+/*
+ * Calculates sin(f*fx) and cos(f*fx) for each distinct frequency.
  *
- * tdb -- TDB to be used for calculations. TT may be used for all but the most
- *        exacting applications. Must be between 1700-01-01 and 2100-01-24.
- * pos -- On success, the heliocentric rectangular coordinates of Pluto in AU.
- *        The reference frame is the equinox and equator of J2000.
+ * t -- The Julian date.
+ * sn -- The sines.
+ * cs -- The cosines.
+ */
+static void frequency_sincos(double t, double *sn, double *cs)
+{
+	int i;
+	double fx = t - PLUTO_MIN_DATE - 73060.0;
+
+	for (i = 0; i < PLUTO_FREQUENCY_COUNT; i++)
+		sincos(fq[i] * fx, &sn[i], &cs[i]);
+}
+
+/*
+ * Sums up the theory from the sines & cosines of its distinct frequencies.
  *
- * Return: SUCCESS -- If the coordinates were calculated successfully.
- *         ERR_INVALID_DATE -- If tdb was out of range for the theory.
+ * t -- The Julian date.
+ * sn -- sin(f*fx) for each distinct frequency.
+ * cs -- cos(f*fx) for each distinct frequency.
+ * pos -- The heliocentric rectangular coordinates of Pluto in AU.
  */
-int pluto_coordinates(struct julian_date *tdb,
+static void sum_terms(double t, const double *sn, const double *cs,
 		struct rectangular_coordinates *pos)
 {
-	int i,j;
-	double t,x[4],fx,sn,cs;
+	int i,j,k;
+	double x[4];
 	struct rectangular_coordinates sec,per;
 
-	t = tdb->date1 + tdb->date2;
-	if (t < PLUTO_MIN_DATE || t > PLUTO_MAX_DATE)
-		return ERR_INVALID_DATE;
-
 	x[0] = 1;
 	x[1] = ((t - PLUTO_MIN_DATE) / 73060.0) - 1;
 	x[2] = x[1] * x[1];
 	x[3] = x[2] * x[1];
 
-	fx = t - PLUTO_MIN_DATE - 73060.0;
-
 	sec.x = 0;
 	sec.y = 0;
 	sec.z = 0;
@@ -229,16 +244,155 @@ int pluto_coordinates(struct julian_date *tdb,
 		if (i == 101)
 			j = 2;
 
-		sincos(fq[i] * fx, &sn, &cs);
+		k = i < PLUTO_FREQUENCY_COUNT ? i :
+			poisson_frequency[i - PLUTO_FREQUENCY_COUNT];
 
-		per.x += (cx[i] * cs + sx[i] * sn) * x[j];
-		per.y += (cy[i] * cs + sy[i] * sn) * x[j];
-		per.z += (cz[i] * cs + sz[i] * sn) * x[j];
+		per.x += (cx[i] * cs[k] + sx[i] * sn[k]) * x[j];
+		per.y += (cy[i] * cs[k] + sy[i] * sn[k]) * x[j];
+		per.z += (cz[i] * cs[k] + sz[i] * sn[k]) * x[j];
 	}
 
 	pos->x = (per.x + sec.x) / 1e10;
 	pos->y = (per.y + sec.y) / 1e10;
 	pos->z = (per.z + sec.z) / 1e10;
+}
+
+/*
+ * Calculates the heliocentric rectangular coordinates of Pluto using an
+ * analytical model developed at the Bureau des Longitudes (Pluto95). This theory
+ * is valid only between Jan 01, 1700 (inclusive) and Jan 24, 2100 (exclusive).
+ *
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications. Must be between 1700-01-01 and 2100-01-24.
+ * pos -- On success, the heliocentric rectangular coordinates of Pluto in AU.
+ *        The reference frame is the equinox and equator of J2000.
+ *
+ * Return: SUCCESS -- If the coordinates were calculated successfully.
+ *         ERR_INVALID_DATE -- If tdb was out of range for the theory.
+ */
+int pluto_coordinates(struct julian_date *tdb,
+		struct rectangular_coordinates *pos)
+{
+	return pluto_coordinates_batch(tdb, 1, pos);
+}
+
+/*
+ * Calculates the heliocentric rectangular coordinates of Pluto at a number of
+ * epochs with the Pluto95 theory. The sines & cosines are calculated once for
+ * each of the PLUTO_FREQUENCY_COUNT distinct frequencies of an epoch, and
+ * shared by the Poisson terms that repeat them. The coordinates are the same
+ * to the bit as those of pluto_coordinates().
+ *
+ * tdb -- Array of n TDBs to be used for calculations. TT may be used for all
+ *        but the most exacting applications. Each must be between 1700-01-01
+ *        and 2100-01-24.
+ * n -- The number of epochs in tdb.
+ * pos -- Array of n elements that will contain the heliocentric rectangular
+ *        coordinates of Pluto in AU. The reference frame is the equinox and
+ *        equator of J2000.
+ *
+ * Return: SUCCESS -- If the coordinates were calculated successfully.
+ *         ERR_INVALID_DATE -- If any epoch was out of range for the theory.
+ *                             No coordinates are calculated then.
+ */
+int pluto_coordinates_batch(const struct julian_date *tdb, size_t n,
+		struct rectangular_coordinates *pos)
+{
+	size_t k;
+	double t,sn[PLUTO_FREQUENCY_COUNT],cs[PLUTO_FREQUENCY_COUNT];
+
+	for (k = 0; k < n; k++) {
+		t = tdb[k].date1 + tdb[k].date2;
+		if (t < PLUTO_MIN_DATE || t > PLUTO_MAX_DATE)
+			return ERR_INVALID_DATE;
+	}
+
+	for (k = 0; k < n; k++) {
+		t = tdb[k].date1 + tdb[k].date2;
+		frequency_sincos(t, sn, cs);
+		sum_terms(t, sn, cs, &pos[k]);
+	}
+
+	return SUCCESS;
+}
+
+/*
+ * Prepares to calculate the heliocentric rectangular coordinates of Pluto
+ * with the Pluto95 theory on a uniform grid of epochs. The stepper keeps
+ * sin(f*t) and cos(f*t) for every distinct frequency in the theory and
+ * advances them by a rotation through f*step, so that no trigonometric
+ * functions are evaluated from one step to the next. They are calculated
+ * afresh every PLUTO_STEPPER_RESEED steps to bound the drift. The
+ * coordinates agree with pluto_coordinates() to within
+ * PLUTO_STEPPER_TOLERANCE AU. A stepper holds no memory to be released.
+ *
+ * st -- The stepper.
+ * tdb -- The first epoch. TDB to be used for calculations. TT may be used
+ *        for all but the most exacting applications. Must be between
+ *        1700-01-01 and 2100-01-24.
+ * step -- The interval between consecutive epochs in days. May be negative.
+ *
+ * Return: SUCCESS -- If the stepper has been initialized.
+ *         ERR_INVALID_DATE -- If tdb was out of range for the theory.
+ */
+int pluto_stepper_init(struct pluto_stepper *st, struct julian_date *tdb,
+		double step)
+{
+	int i;
+	double t;
+
+	t = tdb->date1 + tdb->date2;
+	if (t < PLUTO_MIN_DATE || t > PLUTO_MAX_DATE)
+		return ERR_INVALID_DATE;
+
+	st->tdb = *tdb;
+	st->step = step;
+	st->count = 0;
+
+	for (i = 0; i < PLUTO_FREQUENCY_COUNT; i++)
+		sincos(fq[i] * step, &st->sd[i], &st->cd[i]);
+
+	frequency_sincos(t, st->sn, st->cs);
+	return SUCCESS;
+}
+
+/*
+ * Calculates the coordinates of Pluto at the stepper's current epoch and
+ * advances the stepper to the next epoch. The first call returns the
+ * coordinates at the epoch passed to pluto_stepper_init().
+ *
+ * st -- The stepper.
+ * pos -- On success, the heliocentric rectangular coordinates of Pluto in AU.
+ *        The reference frame is the equinox and equator of J2000.
+ *
+ * Return: SUCCESS -- If the coordinates were calculated successfully.
+ *         ERR_INVALID_DATE -- If the current epoch is past the range of the
+ *                             theory. The stepper is not advanced then.
+ */
+int pluto_stepper_next(struct pluto_stepper *st,
+		struct rectangular_coordinates *pos)
+{
+	int i;
+	double t,s;
+
+	t = st->tdb.date1 + st->tdb.date2 + st->count * st->step;
+	if (t < PLUTO_MIN_DATE || t > PLUTO_MAX_DATE)
+		return ERR_INVALID_DATE;
+
+	sum_terms(t, st->sn, st->cs, pos);
+
+	/* Rotate every (cos, sin) pair through f*step */
+	st->count++;
+	if (st->count % PLUTO_STEPPER_RESEED == 0) {
+		frequency_sincos(st->tdb.date1 + st->tdb.date2 +
+			st->count * st->step, st->sn, st->cs);
+	} else {
+		for (i = 0; i < PLUTO_FREQUENCY_COUNT; i++) {
+			s = st->sn[i] * st->cd[i] + st->cs[i] * st->sd[i];
+			st->cs[i] = st->cs[i] * st->cd[i] - st->sn[i] * st->sd[i];
+			st->sn[i] = s;
+		}
+	}
 
 	return SUCCESS;
 }
@@ -19,13 +19,46 @@
 #ifndef _PLUTO_H_
 #define _PLUTO_H_
 
+#include <stddef.h>
 #include <julian_date.h>
 #include <coordinates.h>
 
 #define PLUTO_MIN_DATE          2341972.5
 #define PLUTO_MAX_DATE          2488092.5
 
+/* Number of distinct frequencies in the periodic & Poisson terms */
+#define PLUTO_FREQUENCY_COUNT   82
+
+/*
+ * A stepper calculates sin() and cos() of its arguments afresh every
+ * PLUTO_STEPPER_RESEED steps. Over the whole range of the theory, with steps
+ * of any size up to 10 days, its coordinates agree with pluto_coordinates()
+ * to within PLUTO_STEPPER_TOLERANCE AU.
+ */
+#define PLUTO_STEPPER_RESEED    1024
+#define PLUTO_STEPPER_TOLERANCE 1E-11
+
+/* State of a fixed-step evaluation. See pluto_stepper_init(). */
+struct pluto_stepper {
+	struct julian_date tdb;	/* The first epoch */
+	double step;		/* Interval between epochs in days */
+	long count;		/* Number of steps taken so far */
+	double sn[PLUTO_FREQUENCY_COUNT];	/* sin(f*t) for each frequency */
+	double cs[PLUTO_FREQUENCY_COUNT];	/* cos(f*t) for each frequency */
+	double sd[PLUTO_FREQUENCY_COUNT];	/* sin(f*step) */
+	double cd[PLUTO_FREQUENCY_COUNT];	/* cos(f*step) */
+};
+
 int pluto_coordinates(struct julian_date *tdb,
 		struct rectangular_coordinates *pos);
 
+int pluto_coordinates_batch(const struct julian_date *tdb, size_t n,
+		struct rectangular_coordinates *pos);
+
+int pluto_stepper_init(struct pluto_stepper *st, struct julian_date *tdb,
+		double step);
+
+int pluto_stepper_next(struct pluto_stepper *st,
+		struct rectangular_coordinates *pos);
+
 #endif
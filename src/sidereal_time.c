@@ -27,9 +27,13 @@
 #include <math.h>
 #include <kepler.h>
 #include <fund_args.h>
+#include <harmonic.h>
 #include <iau2000a_nutation.h>
 #include <sidereal_time.h>
 
+/* Largest multiple of a fundamental argument in the series for the EE */
+#define EOE_MAX_MULTIPLE	13
+
 /* Series for calculating the equation of the equinoxes (Reference 2) */
 struct equation_of_equinoxes_term eoe_series[] = {
 	{2640.96, -0.39,  0,  0,  0,  0,  1,  0,  0,  0},
@@ -144,34 +148,48 @@ double apparent_sidereal_time(struct julian_date *ut1, struct julian_date *tdb,
 double equation_of_the_equinoxes(struct julian_date *tdb)
 {
 	int i;
-	double t,obl,d_lon,d_obl,l,lp,f,d,om,l_ve,l_ea,pre,phi,eqe;
+	short m[8];
+	double t,obl,d_lon,d_obl,s_om,s_phi,c_phi,eqe;
+	struct harmonic_table l,lp,f,d,om,l_ve,l_ea,pre;
+	const struct harmonic_table *h[8] = {&l, &lp, &f, &d, &om, &l_ve, &l_ea,
+		&pre};
 
-	/* Fundamental arguments for the EE */
+	/* Multiples of the fundamental arguments for the EE */
 	t    = JULIAN_CENTURIES(tdb->date1, tdb->date2);
-	l    = fundamental_argument(ARG_ANOMALY_MOON, t);
-	lp   = fundamental_argument(ARG_ANOMALY_SUN, t);
-	f    = fundamental_argument(ARG_LATITUDE_MOON, t);
-	d    = fundamental_argument(ARG_ELONGATION_MOON, t);
-	om   = fundamental_argument(ARG_LONGITUDE_NODE, t);
-	l_ve = fundamental_argument(ARG_LONGITUDE_VENUS, t);
-	l_ea = fundamental_argument(ARG_LONGITUDE_EARTH, t);
-	pre  = fundamental_argument(ARG_PRECESSION, t);
+	harmonic_table(fundamental_argument(ARG_ANOMALY_MOON, t), EOE_MAX_MULTIPLE,
+		&l);
+	harmonic_table(fundamental_argument(ARG_ANOMALY_SUN, t), EOE_MAX_MULTIPLE,
+		&lp);
+	harmonic_table(fundamental_argument(ARG_LATITUDE_MOON, t), EOE_MAX_MULTIPLE,
+		&f);
+	harmonic_table(fundamental_argument(ARG_ELONGATION_MOON, t), EOE_MAX_MULTIPLE,
+		&d);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_NODE, t), EOE_MAX_MULTIPLE,
+		&om);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_VENUS, t), EOE_MAX_MULTIPLE,
+		&l_ve);
+	harmonic_table(fundamental_argument(ARG_LONGITUDE_EARTH, t), EOE_MAX_MULTIPLE,
+		&l_ea);
+	harmonic_table(fundamental_argument(ARG_PRECESSION, t), EOE_MAX_MULTIPLE,
+		&pre);
+	s_om = om.z[HARMONIC_MAX_MULTIPLE + 1][1];
 
 	/* Sum up the series for the equation of the equinoxes */
 	eqe = 0;
 	for (i = 0; i < sizeof(eoe_series) / sizeof(eoe_series[0]); i++) {
-		phi  = eoe_series[i].l * l +
-			eoe_series[i].lp * lp +
-			eoe_series[i].f * f +
-			eoe_series[i].d * d +
-			eoe_series[i].om * om +
-			eoe_series[i].l_ve * l_ve +
-			eoe_series[i].l_ea * l_ea +
-			eoe_series[i].pre * pre;
-
-		eqe += eoe_series[i].si * sin(phi) +
-			eoe_series[i].ci * cos(phi) -
-			0.87 * t * sin(om);
+		m[0] = eoe_series[i].l;
+		m[1] = eoe_series[i].lp;
+		m[2] = eoe_series[i].f;
+		m[3] = eoe_series[i].d;
+		m[4] = eoe_series[i].om;
+		m[5] = eoe_series[i].l_ve;
+		m[6] = eoe_series[i].l_ea;
+		m[7] = eoe_series[i].pre;
+		harmonic_sincos(m, h, 8, &s_phi, &c_phi);
+
+		eqe += eoe_series[i].si * s_phi +
+			eoe_series[i].ci * c_phi -
+			0.87 * t * s_om;
 	}
 	eqe *= UAS_TO_RAD;
 
@@ -23,59 +23,1725 @@
 
 #include <math.h>
 #include <memory.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <vsop87.h>
+#include <arg_reduction.h>
+#include <codegen.h>
 
-#define PLANET_SERIES_COUNT		18
+#define PLANET_SERIES_COUNT		VSOP87_SERIES_PER_BODY
 
-/* These arrays in vsop87_data.c contain the series of terms for VSOP87(A) */
-extern struct vsop87_term *planets_terms[]; 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VSOP87_X86_KERNELS
+
+#define KERNEL_SUFFIX	sse2
+#define KERNEL_TARGET	"sse2"
+#define KERNEL_WIDTH	2
+#include <vsop87_kernel.h>
+
+#define KERNEL_SUFFIX	avx2
+#define KERNEL_TARGET	"avx2,fma"
+#define KERNEL_WIDTH	4
+#include <vsop87_kernel.h>
+
+#define KERNEL_SUFFIX	avx512
+#define KERNEL_TARGET	"avx512f"
+#define KERNEL_WIDTH	8
+#include <vsop87_kernel.h>
+#endif
+
+#ifdef __GNUC__
+#define VSOP87_GENERIC_KERNEL
+
+/*
+ * The reproducible kernel is not tied to an instruction set. Every series
+ * is summed in 2 lanes in a fixed order, whatever the width of the vector
+ * registers, so it gives the same bits on every CPU that rounds doubles as
+ * IEEE 754 requires (on x86, any CPU with SSE2).
+ */
+#define KERNEL_SUFFIX	generic
+#define KERNEL_WIDTH	2
+#include <vsop87_kernel.h>
+
+/* Keeps a*b + c from being fused, as in the reproducible kernel */
+#define NO_CONTRACT	__attribute__((optimize("fp-contract=off")))
+#else
+#define NO_CONTRACT
+#endif
+
+/* This array in vsop87_data.c contains the series of terms for VSOP87(A) */
+extern const struct vsop87_series planets_series[];
+
+/*
+ * Series summation routines for an instruction set. The others evaluate
+ * the factored form of the theory, one epoch or width epochs at a time, and
+ * those ending in _f do it in single precision with twice as many lanes.
+ * They are NULL for the scalar kernel, which always sums up the original
+ * terms one by one. The generated kernel has straight-line sums for the
+ * planets of the built-in theory, and uses the others where it has none.
+ */
+struct series_kernel {
+	int width;
+	void (*series_sum)(const struct vsop87_series *s, const double *t, int m,
+			double *sum);
+	void (*reduce_table)(const double *hi, const double *lo, int n,
+			double whole, double frac, double *x);
+	void (*reduce_block)(const double *hi, const double *lo, int n,
+			const double *whole, const double *frac, int m, double *x);
+	void (*sincos_table)(const double *x, int n, double *sn, double *cs);
+	double (*factored_sum)(const double *ac, const double *as, const int *f,
+			int n, const double *sn, const double *cs);
+	void (*factored_block)(const double *ac, const double *as, const int *f,
+			int n, const double *sn, const double *cs, double *sum);
+	double (*factored_state)(const double *ac, const double *as,
+			const int *f, int n, const double *freq, const double *sn,
+			const double *cs, double *deriv);
+	void (*sincos_table_f)(const double *x, int n, float *sn, float *cs);
+	double (*factored_sum_f)(const float *ac, const float *as,
+			const int *f, int n, const float *sn, const float *cs);
+	void (*factored_block_f)(const float *ac, const float *as,
+			const int *f, int n, const float *sn, const float *cs,
+			double *sum);
+	const struct generated_planet *generated;
+};
+
+static void series_sum_scalar(const struct vsop87_series *s,
+		const double *t, int m, double *sum);
+
+#define SERIES_KERNEL(width, isa)	{width, series_sum_##isa, \
+	reduce_table_##isa, reduce_block_##isa, sincos_table_##isa, \
+	factored_sum_##isa, factored_block_##isa, factored_state_##isa, \
+	sincos_table_f_##isa, factored_sum_f_##isa, factored_block_f_##isa, 0}
+
+/* Indexed by enum vsop87_kernel */
+static struct series_kernel series_kernels[] = {
+	{1, series_sum_scalar, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+#ifdef VSOP87_X86_KERNELS
+	SERIES_KERNEL(2, sse2),
+	SERIES_KERNEL(4, avx2),
+	SERIES_KERNEL(8, avx512),
+#else
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+#endif
+#ifdef VSOP87_GENERIC_KERNEL
+	/*
+	 * Several epochs at once would be summed in a different order than
+	 * one epoch, so every epoch is calculated on its own.
+	 */
+	{2, series_sum_generic, reduce_table_generic, 0,
+		sincos_table_generic, factored_sum_generic, 0,
+		factored_state_generic, sincos_table_f_generic,
+		factored_sum_f_generic, 0, 0},
+#else
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+#endif
+#if defined(VSOP87_GENERIC_KERNEL) && defined(KEPLER_GENERATED)
+	/* The sines & cosines come from the reproducible kernel */
+	{2, series_sum_generic, reduce_table_generic, 0,
+		sincos_table_generic, factored_sum_generic, 0,
+		factored_state_generic, sincos_table_f_generic,
+		factored_sum_f_generic, 0, generated_planets}
+#else
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
+#endif
+};
+
+static enum vsop87_kernel current_kernel = VSOP87_KERNEL_SCALAR;
+
+/*
+ * Many terms of a planet share the same frequency c, both within a series
+ * and across the x/y/z series and powers of t. The factored form of the
+ * theory stores each term a*cos(b + c*t) as ac*cos(c*t) - as*sin(c*t), with
+ * ac = a*cos(b) and as = a*sin(b) precomputed and c replaced by an index
+ * into the planet's table of unique frequencies. Each evaluation then needs
+ * one sincos() per unique frequency instead of one cos() per term. Each
+ * frequency is also kept in radians per day for reduce_argument(), so that
+ * c*t is reduced exactly to a small angle, however far the epoch is from
+ * J2000.
+ *
+ * All arrays are padded with zero terms to a multiple of FACTORED_PADDING,
+ * so that the kernels never need to handle a partial vector.
+ */
+#define FACTORED_PADDING	16
+#define MAX_FREQUENCIES		2048
+
+struct factored_planet {
+	int ready;
+	int freq_count;
+	double *freq;
+	double *rate_hi;
+	double *rate_lo;
+	int count[PLANET_SERIES_COUNT];
+	double *ac[PLANET_SERIES_COUNT];
+	double *as[PLANET_SERIES_COUNT];
+	int *f[PLANET_SERIES_COUNT];
+	void *mem;
+};
+
+static struct factored_planet factored[NEPTUNE + 1];
+
+/*
+ * For truncated evaluation, the factored terms of each series are sorted by
+ * decreasing amplitude, and tail[i] holds the sum of the amplitudes of the
+ * terms from i onwards. The terms are padded like the factored form, so
+ * tail[count] is always 0. The frequencies are ranked by the largest
+ * amplitude that refers to them, so that the first i terms of a series need
+ * only the first reach[i] frequencies.
+ */
+struct sorted_planet {
+	int ready;
+	double *freq;
+	double *rate_hi;
+	double *rate_lo;
+	double *ac[PLANET_SERIES_COUNT];
+	double *as[PLANET_SERIES_COUNT];
+	int *f[PLANET_SERIES_COUNT];
+	double *tail[PLANET_SERIES_COUNT];
+	int *reach[PLANET_SERIES_COUNT];
+	void *mem;
+};
+
+/* A frequency and the largest amplitude of the terms that refer to it */
+struct ranked_frequency {
+	double amplitude;
+	int index;
+};
+
+static struct sorted_planet sorted[NEPTUNE + 1];
+
+/*
+ * The single precision form of the theory has the amplitudes of the
+ * factored form rounded to floats. The frequencies and their indices are
+ * shared with the factored form, so that c*t is still calculated and
+ * reduced in double precision.
+ */
+struct fast_planet {
+	int ready;
+	float *ac[PLANET_SERIES_COUNT];
+	float *as[PLANET_SERIES_COUNT];
+	void *mem;
+};
+
+static struct fast_planet fast[NEPTUNE + 1];
+
+/* Serializes building the factored & sorted forms of the theory */
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The Earth's position is needed at the same epoch by almost every
+ * geocentric calculation. When enabled with vsop87_earth_cache(), each
+ * thread keeps the Earth's coordinates at the last few epochs, most
+ * recently used first. An entry is only reused with the kernel that
+ * calculated it, so that the results are the same with or without the
+ * cache.
+ */
+struct earth_entry {
+	double date1;
+	double date2;
+	int velocity;		/* Calculated by vsop87_state() */
+	enum vsop87_kernel kernel;
+	struct rectangular_coordinates pos;
+	struct rectangular_coordinates vel;
+};
+
+struct earth_cache {
+	unsigned int size;
+	unsigned int count;
+	unsigned long hits;
+	unsigned long misses;
+	struct earth_entry entry[VSOP87_EARTH_CACHE_MAX];
+};
+
+static __thread struct earth_cache earth_cache;
+
+/*
+ * Adds the terms a*cos(b + c*t) of a series to the sums for a block of
+ * epochs, one term at a time using cos() from the C library. The results
+ * are the reference for the vectorized kernels in vsop87_kernel.h.
+ *
+ * s -- The series.
+ * t -- The epochs in Julian millennia from J2000.
+ * m -- The number of epochs in t.
+ * sum -- The sum for each epoch, updated in-place.
+ */
+static void series_sum_scalar(const struct vsop87_series *s,
+		const double *t, int m, double *sum)
+{
+	int i,j;
+
+	for (i = 0; i < s->count; i++) {
+		for (j = 0; j < m; j++)
+			sum[j] += (s->a[i] * cos(s->b[i] + s->c[i] * t[j]));
+	}
+}
+
+/*
+ * Sums up a series of terms a*cos(b + c*t) and its derivative with respect
+ * to t at a single epoch.
+ *
+ * s -- The series.
+ * t -- The epoch in Julian millennia from J2000.
+ * deriv -- The derivative of the series.
+ *
+ * Return: The sum of the series.
+ */
+static double series_state_scalar(const struct vsop87_series *s, double t,
+		double *deriv)
+{
+	int i;
+	double arg,sum;
+
+	sum = 0;
+	*deriv = 0;
+	for (i = 0; i < s->count; i++) {
+		arg = s->b[i] + s->c[i] * t;
+		sum += (s->a[i] * cos(arg));
+		*deriv -= s->a[i] * s->c[i] * sin(arg);
+	}
+
+	return sum;
+}
+
+/* Orders doubles, for use with qsort() & bsearch() */
+static int compare_double(const void *x, const void *y)
+{
+	double c1 = *(const double *)x;
+	double c2 = *(const double *)y;
+
+	return (c1 > c2) - (c1 < c2);
+}
+
+/*
+ * Builds the factored form of the theory for a body.
+ *
+ * series -- The 18 series x0..x5, y0..y5, z0..z5 of the body.
+ * fp -- The factored terms and table of unique frequencies.
+ *
+ * Return: 1 -- If the factored form has been built.
+ *         0 -- If memory could not be allocated or the planet has too many
+ *              unique frequencies.
+ */
+static int build_factored(const struct vsop87_series *series,
+		struct factored_planet *fp)
+{
+	int i,j,k,n,total,unique;
+	size_t size;
+	char *mem;
+	const struct vsop87_series *s;
+
+	total = 0;
+	size = 0;
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		n = series[i].count;
+		total += n;
+		fp->count[i] = (n + FACTORED_PADDING - 1) / FACTORED_PADDING *
+			FACTORED_PADDING;
+		size += fp->count[i] * (2 * sizeof(double) + sizeof(int));
+	}
+
+	mem = malloc(size + 3 * (total + FACTORED_PADDING) * sizeof(double));
+	if (!mem)
+		return 0;
+
+	/* Doubles first, then ints, so that everything stays aligned */
+	fp->mem = mem;
+	fp->freq = (double *)mem;
+	mem += (total + FACTORED_PADDING) * sizeof(double);
+	fp->rate_hi = (double *)mem;
+	mem += (total + FACTORED_PADDING) * sizeof(double);
+	fp->rate_lo = (double *)mem;
+	mem += (total + FACTORED_PADDING) * sizeof(double);
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		fp->ac[i] = (double *)mem;
+		mem += fp->count[i] * sizeof(double);
+		fp->as[i] = (double *)mem;
+		mem += fp->count[i] * sizeof(double);
+	}
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		fp->f[i] = (int *)mem;
+		mem += fp->count[i] * sizeof(int);
+	}
+
+	/* Collect the unique frequencies */
+	for (i = 0, k = 0; i < PLANET_SERIES_COUNT; i++) {
+		s = &series[i];
+		memcpy(fp->freq + k, s->c, s->count * sizeof(double));
+		k += s->count;
+	}
+	qsort(fp->freq, total, sizeof(double), compare_double);
+
+	for (i = 0, n = 0; i < total; i++) {
+		if (n == 0 || fp->freq[i] != fp->freq[n - 1])
+			fp->freq[n++] = fp->freq[i];
+	}
+
+	unique = n;
+	fp->freq_count = (n + FACTORED_PADDING - 1) / FACTORED_PADDING *
+		FACTORED_PADDING;
+	if (fp->freq_count > MAX_FREQUENCIES) {
+		free(fp->mem);
+		return 0;
+	}
+	for (; n < fp->freq_count; n++)
+		fp->freq[n] = 0;
+	for (i = 0; i < fp->freq_count; i++)
+		reduction_rate(fp->freq[i], 1.0, JULIAN_MILLENNIUM_LENGTH,
+			&fp->rate_hi[i], &fp->rate_lo[i]);
+
+	/* Factor the terms, looking up each frequency in the sorted table */
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		s = &series[i];
+		n = s->count;
+#ifdef VSOP87_GENERIC_KERNEL
+		/*
+		 * cos(b) & sin(b) come from the reproducible kernel rather than
+		 * the C library, so that the factored terms are the same on
+		 * every machine. The phases are padded to VSOP87_TERM_PADDING,
+		 * a multiple of the width of the kernel.
+		 */
+		sincos_table_generic(s->b, (n + VSOP87_TERM_PADDING - 1) /
+			VSOP87_TERM_PADDING * VSOP87_TERM_PADDING, fp->as[i],
+			fp->ac[i]);
+#else
+		for (j = 0; j < n; j++) {
+			fp->ac[i][j] = cos(s->b[j]);
+			fp->as[i][j] = sin(s->b[j]);
+		}
+#endif
+		for (j = 0; j < fp->count[i]; j++) {
+			if (j < n) {
+				fp->ac[i][j] *= s->a[j];
+				fp->as[i][j] *= s->a[j];
+				fp->f[i][j] = (double *)bsearch(&s->c[j], fp->freq,
+					unique, sizeof(double),
+					compare_double) - fp->freq;
+			} else {
+				fp->ac[i][j] = 0;
+				fp->as[i][j] = 0;
+				fp->f[i][j] = 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Returns the factored form of the theory for a body, building it on first
+ * use.
+ *
+ * series -- The 18 series of the body.
+ * fp -- Where the factored terms are kept.
+ *
+ * Return: fp or NULL if the factored terms could not be built.
+ */
+static struct factored_planet *prepare_factored(
+		const struct vsop87_series *series, struct factored_planet *fp)
+{
+	if (!__atomic_load_n(&fp->ready, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_lock(&tables_lock);
+		if (!fp->ready)
+			__atomic_store_n(&fp->ready,
+					build_factored(series, fp) ? 1 : -1,
+					__ATOMIC_RELEASE);
+		pthread_mutex_unlock(&tables_lock);
+	}
+
+	return fp->ready > 0 ? fp : NULL;
+}
+
+/*
+ * Returns the factored form of the built-in theory for a planet, building it
+ * on first use.
+ *
+ * planet -- The planet whose factored terms are needed.
+ *
+ * Return: The factored terms or NULL if they could not be built.
+ */
+static struct factored_planet *get_factored(int planet)
+{
+	return prepare_factored(&planets_series[planet * PLANET_SERIES_COUNT],
+			&factored[planet]);
+}
+
+/* Orders pointers to amplitudes by decreasing magnitude, for qsort() */
+static int compare_amplitude(const void *x, const void *y)
+{
+	double a1 = fabs(**(const double **)x);
+	double a2 = fabs(**(const double **)y);
+
+	return (a1 < a2) - (a1 > a2);
+}
+
+/* Orders frequencies by decreasing amplitude, for use with qsort() */
+static int compare_rank(const void *x, const void *y)
+{
+	const struct ranked_frequency *r1 = x;
+	const struct ranked_frequency *r2 = y;
+
+	if (r1->amplitude != r2->amplitude)
+		return (r1->amplitude < r2->amplitude) -
+			(r1->amplitude > r2->amplitude);
+	return r1->index - r2->index;
+}
+
+/*
+ * Builds the amplitude sorted form of the theory for a planet from its
+ * factored form.
+ *
+ * planet -- The planet whose terms are to be sorted.
+ * fp -- The planet's factored terms.
+ * sp -- The sorted terms and cumulative amplitudes.
+ *
+ * Return: 1 -- If the sorted form has been built.
+ *         0 -- If memory could not be allocated.
+ */
+static int build_sorted(int planet, struct factored_planet *fp,
+		struct sorted_planet *sp)
+{
+	int i,j,k,n,total,rank[MAX_FREQUENCIES];
+	char *mem;
+	const double **order;
+	const struct vsop87_series *s;
+	struct ranked_frequency ranked[MAX_FREQUENCIES];
+
+	total = 0;
+	for (i = 0; i < PLANET_SERIES_COUNT; i++)
+		total += fp->count[i];
+
+	order = malloc(total * sizeof(*order));
+	mem = malloc(3 * fp->freq_count * sizeof(double) +
+		total * (3 * sizeof(double) + 2 * sizeof(int)) +
+		PLANET_SERIES_COUNT * (sizeof(double) + sizeof(int)));
+	if (!order || !mem) {
+		free(order);
+		free(mem);
+		return 0;
+	}
+
+	/* Doubles first, then ints, so that everything stays aligned */
+	sp->mem = mem;
+	sp->freq = (double *)mem;
+	mem += fp->freq_count * sizeof(double);
+	sp->rate_hi = (double *)mem;
+	mem += fp->freq_count * sizeof(double);
+	sp->rate_lo = (double *)mem;
+	mem += fp->freq_count * sizeof(double);
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		sp->ac[i] = (double *)mem;
+		mem += fp->count[i] * sizeof(double);
+		sp->as[i] = (double *)mem;
+		mem += fp->count[i] * sizeof(double);
+		sp->tail[i] = (double *)mem;
+		mem += (fp->count[i] + 1) * sizeof(double);
+	}
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		sp->f[i] = (int *)mem;
+		mem += fp->count[i] * sizeof(int);
+		sp->reach[i] = (int *)mem;
+		mem += (fp->count[i] + 1) * sizeof(int);
+	}
+
+	/* Rank the frequencies by the largest amplitude that uses them */
+	for (k = 0; k < fp->freq_count; k++) {
+		ranked[k].amplitude = 0;
+		ranked[k].index = k;
+	}
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		s = &planets_series[planet * PLANET_SERIES_COUNT + i];
+		for (j = 0; j < s->count; j++) {
+			k = fp->f[i][j];
+			ranked[k].amplitude = fmax(ranked[k].amplitude,
+				fabs(s->a[j]));
+		}
+	}
+	qsort(ranked, fp->freq_count, sizeof(*ranked), compare_rank);
+	for (k = 0; k < fp->freq_count; k++) {
+		rank[ranked[k].index] = k;
+		sp->freq[k] = fp->freq[ranked[k].index];
+		sp->rate_hi[k] = fp->rate_hi[ranked[k].index];
+		sp->rate_lo[k] = fp->rate_lo[ranked[k].index];
+	}
+
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		s = &planets_series[planet * PLANET_SERIES_COUNT + i];
+		n = s->count;
+		for (j = 0; j < n; j++)
+			order[j] = s->a + j;
+		qsort(order, n, sizeof(*order), compare_amplitude);
+
+		/* The padding terms have zero amplitude and stay at the end */
+		sp->reach[i][0] = 0;
+		for (j = 0; j < fp->count[i]; j++) {
+			k = j < n ? order[j] - s->a : j;
+			sp->ac[i][j] = fp->ac[i][k];
+			sp->as[i][j] = fp->as[i][k];
+			sp->f[i][j] = j < n ? rank[fp->f[i][k]] : 0;
+			sp->reach[i][j + 1] = sp->f[i][j] + 1 > sp->reach[i][j] ?
+				sp->f[i][j] + 1 : sp->reach[i][j];
+		}
+
+		sp->tail[i][fp->count[i]] = 0;
+		for (j = fp->count[i] - 1; j >= 0; j--)
+			sp->tail[i][j] = sp->tail[i][j + 1] +
+				(j < n ? fabs(*order[j]) : 0);
+	}
+	free(order);
+
+	return 1;
+}
+
+/*
+ * Returns the amplitude sorted form of the theory for a planet, building
+ * it on first use.
+ *
+ * planet -- The planet whose sorted terms are needed.
+ *
+ * Return: The sorted terms or NULL if they could not be built.
+ */
+static struct sorted_planet *get_sorted(int planet)
+{
+	struct sorted_planet *sp = &sorted[planet];
+	struct factored_planet *fp;
+
+	if (!__atomic_load_n(&sp->ready, __ATOMIC_ACQUIRE)) {
+		/* Outside the lock, which get_factored() takes as well */
+		fp = get_factored(planet);
+		pthread_mutex_lock(&tables_lock);
+		if (!sp->ready)
+			__atomic_store_n(&sp->ready,
+					fp && build_sorted(planet, fp, sp) ? 1 : -1,
+					__ATOMIC_RELEASE);
+		pthread_mutex_unlock(&tables_lock);
+	}
+
+	return sp->ready > 0 ? sp : NULL;
+}
+
+/*
+ * Builds the single precision form of the theory for a planet from its
+ * factored form.
+ *
+ * fp -- The planet's factored terms.
+ * xp -- The factored terms with single precision amplitudes.
+ *
+ * Return: 1 -- If the single precision form has been built.
+ *         0 -- If memory could not be allocated.
+ */
+static int build_fast(struct factored_planet *fp, struct fast_planet *xp)
+{
+	int i,j,total;
+	float *mem;
+
+	total = 0;
+	for (i = 0; i < PLANET_SERIES_COUNT; i++)
+		total += fp->count[i];
+
+	mem = malloc(2 * total * sizeof(float));
+	if (!mem)
+		return 0;
+
+	xp->mem = mem;
+	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+		xp->ac[i] = mem;
+		mem += fp->count[i];
+		xp->as[i] = mem;
+		mem += fp->count[i];
+		for (j = 0; j < fp->count[i]; j++) {
+			xp->ac[i][j] = fp->ac[i][j];
+			xp->as[i][j] = fp->as[i][j];
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Returns the single precision form of the theory for a planet, building
+ * it on first use.
+ *
+ * planet -- The planet whose single precision terms are needed.
+ * fp -- The planet's factored terms.
+ *
+ * Return: The single precision terms or NULL if they could not be built.
+ */
+static struct fast_planet *get_fast(int planet, struct factored_planet *fp)
+{
+	struct fast_planet *xp = &fast[planet];
+
+	if (!__atomic_load_n(&xp->ready, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_lock(&tables_lock);
+		if (!xp->ready)
+			__atomic_store_n(&xp->ready, build_fast(fp, xp) ? 1 : -1,
+					__ATOMIC_RELEASE);
+		pthread_mutex_unlock(&tables_lock);
+	}
+
+	return xp->ready > 0 ? xp : NULL;
+}
+
+/*
+ * An epoch and what every planet calculated at it needs from it. It is
+ * worked out once, and shared by the planets and threads of a snapshot.
+ */
+struct planet_epoch {
+	const struct julian_date *tdb;
+	double t;		/* Julian millennia from J2000 */
+	double whole;		/* The epoch from reduction_days() */
+	double frac;
+};
+
+/*
+ * Works out the quantities of an epoch.
+ *
+ * tdb -- The epoch. It must outlive e.
+ * e -- The epoch and its quantities.
+ */
+static void set_epoch(const struct julian_date *tdb, struct planet_epoch *e)
+{
+	e->tdb = tdb;
+	e->t = JULIAN_MILLENNIA(tdb->date1, tdb->date2);
+	reduction_days(tdb, &e->whole, &e->frac);
+}
+
+/*
+ * Reduces c*t modulo 2*PI for a table of frequencies at one epoch, given as
+ * by reduction_days(), with the current kernel, or one frequency at a time
+ * if the kernel has no reduction.
+ *
+ * kernel -- The kernel to be used.
+ * hi, lo -- The frequencies in radians per day, from reduction_rate().
+ * n -- The number of frequencies, a multiple of FACTORED_PADDING.
+ * whole, frac -- The epoch from reduction_days().
+ * x -- The reduced arguments, n elements.
+ */
+static void reduce_split(struct series_kernel *kernel, const double *hi,
+		const double *lo, int n, double whole, double frac, double *x)
+{
+	int i;
+
+	if (kernel->reduce_table) {
+		kernel->reduce_table(hi, lo, n, whole, frac, x);
+	} else {
+		for (i = 0; i < n; i++)
+			x[i] = reduce_argument(hi[i], lo[i], whole, frac);
+	}
+}
+
+/*
+ * Reduces c*t modulo 2*PI for a table of frequencies at one epoch, as
+ * reduce_split().
+ *
+ * kernel -- The kernel to be used.
+ * hi, lo -- The frequencies in radians per day, from reduction_rate().
+ * n -- The number of frequencies, a multiple of FACTORED_PADDING.
+ * tdb -- The epoch.
+ * x -- The reduced arguments, n elements.
+ */
+static void reduce_frequencies(struct series_kernel *kernel,
+		const double *hi, const double *lo, int n,
+		const struct julian_date *tdb, double *x)
+{
+	double whole,frac;
+
+	reduction_days(tdb, &whole, &frac);
+	reduce_split(kernel, hi, lo, n, whole, frac, x);
+}
+
+/*
+ * Sums up a factored series with the current kernel, or term by term if the
+ * kernel has no factored summation.
+ *
+ * kernel -- The kernel to be used.
+ * ac, as, f, n -- The factored series, as for factored_sum().
+ * sn, cs -- sin(c*t) and cos(c*t) for each frequency.
+ *
+ * Return: The sum of the series.
+ */
+static double sum_factored(struct series_kernel *kernel, const double *ac,
+		const double *as, const int *f, int n, const double *sn,
+		const double *cs)
+{
+	int j;
+	double sum;
+
+	if (kernel->factored_sum)
+		return kernel->factored_sum(ac, as, f, n, sn, cs);
+
+	sum = 0;
+	for (j = 0; j < n; j++)
+		sum += ac[j] * cs[f[j]] - as[j] * sn[f[j]];
+
+	return sum;
+}
+
+/*
+ * Sums up the 18 series of a planet at one epoch with the straight-line
+ * functions of the generated kernel.
+ *
+ * kernel -- The generated kernel.
+ * planet -- The planet for calculations.
+ * e -- The epoch.
+ * sum -- The sums of the series x0..x5, y0..y5, z0..z5.
+ */
+static void generated_sums(struct series_kernel *kernel, int planet,
+		const struct planet_epoch *e, double *sum)
+{
+	double x[MAX_FREQUENCIES],sn[MAX_FREQUENCIES],cs[MAX_FREQUENCIES];
+	const struct generated_planet *gp = &kernel->generated[planet];
+
+	reduce_split(kernel, gp->rate_hi, gp->rate_lo, gp->freq_count,
+		e->whole, e->frac, x);
+	kernel->sincos_table(x, gp->freq_count, sn, cs);
+	gp->sum(sn, cs, sum);
+}
+
+/*
+ * Combines the sums of the series x0..x5, y0..y5, z0..z5 into a position.
+ *
+ * sum -- The sums of the 18 series of a planet.
+ * stride -- The distance between consecutive sums in sum.
+ * t -- The epoch in Julian millennia from J2000.
+ * pos -- The planet's heliocentric rectangular coordinates in AU.
+ */
+static NO_CONTRACT void series_to_position(const double *sum, int stride, double t,
+		struct rectangular_coordinates *pos)
+{
+	int i;
+	double xyz[3];
+
+	for (i = 0; i < PLANET_SERIES_COUNT; i += 6) {
+		xyz[i / 6] = sum[i * stride] +
+			(sum[(i + 1) * stride] +
+			(sum[(i + 2) * stride] +
+			(sum[(i + 3) * stride] +
+			(sum[(i + 4) * stride] + sum[(i + 5) * stride] * t) *
+			t) * t) * t) * t;
+	}
+
+	pos->x = xyz[0];
+	pos->y = xyz[1];
+	pos->z = xyz[2];
+}
+
+/*
+ * Combines the sums of the series x0..x5, y0..y5, z0..z5 and their
+ * derivatives into a position and velocity.
+ *
+ * sum -- The sums of the 18 series of a planet.
+ * deriv -- The derivatives of the 18 series with respect to t.
+ * t -- The epoch in Julian millennia from J2000.
+ * pos -- The planet's heliocentric rectangular coordinates in AU.
+ * vel -- The planet's heliocentric velocity in AU/day.
+ */
+static NO_CONTRACT void series_to_state(const double *sum, const double *deriv,
+		double t, struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	int i,k;
+	double p,d,xyz[3],dxyz[3];
+
+	for (i = 0; i < PLANET_SERIES_COUNT; i += 6) {
+		/* d/dt of p*t + s is d*t + p + ds/dt */
+		p = sum[i + 5];
+		d = deriv[i + 5];
+		for (k = 4; k >= 0; k--) {
+			d = d * t + p + deriv[i + k];
+			p = p * t + sum[i + k];
+		}
+		xyz[i / 6] = p;
+		dxyz[i / 6] = d / JULIAN_MILLENNIUM_LENGTH;
+	}
+
+	pos->x = xyz[0];
+	pos->y = xyz[1];
+	pos->z = xyz[2];
+	vel->x = dxyz[0];
+	vel->y = dxyz[1];
+	vel->z = dxyz[2];
+}
+
+/*
+ * Calculates a body's position, and optionally its velocity, at a single
+ * epoch with the current kernel.
+ *
+ * series -- The 18 series of the body.
+ * fp -- Where the factored terms of the body are kept.
+ * e -- The epoch.
+ * pos -- The three variables of the body.
+ * vel -- The rates of change of the variables per day, or NULL.
+ */
+static void series_state(const struct vsop87_series *series,
+		struct factored_planet *fp, const struct planet_epoch *e,
+		struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	int i;
+	double t,sum[PLANET_SERIES_COUNT],deriv[PLANET_SERIES_COUNT],
+		x[MAX_FREQUENCIES],sn[MAX_FREQUENCIES],cs[MAX_FREQUENCIES];
+	struct series_kernel *kernel;
+
+	/* The scalar kernel always sums up the original terms */
+	kernel = &series_kernels[current_kernel];
+	fp = kernel->factored_state ? prepare_factored(series, fp) : NULL;
+	t = e->t;
+
+	if (fp) {
+		reduce_split(kernel, fp->rate_hi, fp->rate_lo, fp->freq_count,
+			e->whole, e->frac, x);
+		kernel->sincos_table(x, fp->freq_count, sn, cs);
+		for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+			if (vel)
+				sum[i] = kernel->factored_state(fp->ac[i], fp->as[i],
+					fp->f[i], fp->count[i], fp->freq, sn, cs,
+					&deriv[i]);
+			else
+				sum[i] = kernel->factored_sum(fp->ac[i], fp->as[i],
+					fp->f[i], fp->count[i], sn, cs);
+		}
+	} else {
+		for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+			if (vel) {
+				sum[i] = series_state_scalar(&series[i], t, &deriv[i]);
+			} else {
+				sum[i] = 0;
+				kernel->series_sum(&series[i], &t, 1, &sum[i]);
+			}
+		}
+	}
+
+	if (vel)
+		series_to_state(sum, deriv, t, pos, vel);
+	else
+		series_to_position(sum, 1, t, pos);
+}
+
+/*
+ * Calculates a planet's position, and optionally its velocity, at a single
+ * epoch with the built-in theory.
+ *
+ * planet -- The planet for calculations.
+ * e -- The epoch.
+ * pos -- The planet's heliocentric rectangular coordinates in AU.
+ * vel -- The planet's heliocentric velocity in AU/day, or NULL.
+ */
+static void planet_state(int planet, const struct planet_epoch *e,
+		struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	double sum[PLANET_SERIES_COUNT];
+	struct series_kernel *kernel = &series_kernels[current_kernel];
+
+	/* The generated kernel has no derivatives */
+	if (kernel->generated && !vel) {
+		generated_sums(kernel, planet, e, sum);
+		series_to_position(sum, 1, e->t, pos);
+		return;
+	}
+
+	series_state(&planets_series[planet * PLANET_SERIES_COUNT],
+		&factored[planet], e, pos, vel);
+}
+
+/*
+ * Selects the fastest summation kernel supported by the CPU. Called
+ * automatically when the library is loaded.
+ */
+static void __attribute__((constructor)) vsop87_init(void)
+{
+	int k;
+
+	for (k = VSOP87_KERNEL_AVX512; k >= VSOP87_KERNEL_SCALAR; k--) {
+		if (vsop87_set_kernel(k) == SUCCESS)
+			break;
+	}
+}
+
+/*
+ * Selects the routine used to sum up the series in the theory. The fastest
+ * one supported by the CPU is selected when the library is loaded. The
+ * vectorized kernels evaluate the factored form of the theory and agree with
+ * VSOP87_KERNEL_SCALAR to within VSOP87_KERNEL_TOLERANCE AU.
+ *
+ * kernel -- The kernel to be used.
+ *
+ * Return: SUCCESS -- If the kernel has been selected.
+ *         ERR_UNSUPPORTED -- If the kernel is unknown or the CPU does not
+ *                            support its instruction set.
+ */
+int vsop87_set_kernel(enum vsop87_kernel kernel)
+{
+	int ok;
+
+	switch (kernel) {
+	case VSOP87_KERNEL_SCALAR:
+		ok = 1;
+		break;
+#ifdef VSOP87_X86_KERNELS
+	case VSOP87_KERNEL_SSE2:
+		__builtin_cpu_init();
+		ok = __builtin_cpu_supports("sse2");
+		break;
+	case VSOP87_KERNEL_AVX2:
+		__builtin_cpu_init();
+		ok = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		break;
+	case VSOP87_KERNEL_AVX512:
+		__builtin_cpu_init();
+		ok = __builtin_cpu_supports("avx512f");
+		break;
+#endif
+#ifdef VSOP87_GENERIC_KERNEL
+	case VSOP87_KERNEL_REPRODUCIBLE:
+		ok = 1;
+		break;
+#endif
+#if defined(VSOP87_GENERIC_KERNEL) && defined(KEPLER_GENERATED)
+	case VSOP87_KERNEL_GENERATED:
+		ok = 1;
+		break;
+#endif
+	default:
+		ok = 0;
+		break;
+	}
+
+	if (!ok)
+		return ERR_UNSUPPORTED;
+
+	current_kernel = kernel;
+	return SUCCESS;
+}
+
+/*
+ * Returns the routine currently used to sum up the series in the theory.
+ *
+ * Return: The kernel selected by vsop87_set_kernel().
+ */
+enum vsop87_kernel vsop87_get_kernel(void)
+{
+	return current_kernel;
+}
+
+/*
+ * Looks up the Earth's position, and optionally its velocity, in the cache
+ * of the calling thread, calculating it on a miss. The entry becomes the
+ * most recently used one, and the least recently used entry is dropped when
+ * the cache is full.
+ *
+ * tdb -- TDB to be used for calculations.
+ * pos -- The Earth's heliocentric rectangular coordinates in AU.
+ * vel -- If not NULL, the Earth's heliocentric velocity in AU/day.
+ */
+static void earth_cached(struct julian_date *tdb,
+		struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	unsigned int i;
+	struct earth_entry e;
+	struct earth_cache *ec = &earth_cache;
+	struct planet_epoch epoch;
+
+	for (i = 0; i < ec->count; i++) {
+		if (ec->entry[i].date1 == tdb->date1 &&
+			ec->entry[i].date2 == tdb->date2 &&
+			ec->entry[i].velocity == (vel != NULL) &&
+			ec->entry[i].kernel == current_kernel)
+			break;
+	}
+
+	if (i < ec->count) {
+		e = ec->entry[i];
+		ec->hits++;
+	} else {
+		e.date1 = tdb->date1;
+		e.date2 = tdb->date2;
+		e.velocity = vel != NULL;
+		e.kernel = current_kernel;
+		if (vel) {
+			set_epoch(tdb, &epoch);
+			planet_state(EARTH, &epoch, &e.pos, &e.vel);
+		} else
+			vsop87_coordinates_batch(EARTH, tdb, 1, &e.pos);
+
+		if (ec->count < ec->size)
+			ec->count++;
+		i = ec->count - 1;
+		ec->misses++;
+	}
+
+	memmove(&ec->entry[1], &ec->entry[0], i * sizeof(e));
+	ec->entry[0] = e;
+
+	*pos = e.pos;
+	if (vel)
+		*vel = e.vel;
+}
+
+/*
+ * Enables or disables the Earth cache of the calling thread. While it is
+ * enabled, vsop87_coordinates() and vsop87_state() reuse the Earth's
+ * coordinates when they are called again with exactly the same epoch, as
+ * light-time corrections and conversions to geocentric coordinates do for
+ * every body at that epoch. The cache is emptied and its counters are reset.
+ *
+ * entries -- The number of epochs to keep, from 1 to VSOP87_EARTH_CACHE_MAX,
+ *            or 0 to disable the cache.
+ *
+ * Return: SUCCESS -- If the cache has been resized.
+ *         ERR_UNSUPPORTED -- If entries is larger than VSOP87_EARTH_CACHE_MAX.
+ */
+int vsop87_earth_cache(unsigned int entries)
+{
+	if (entries > VSOP87_EARTH_CACHE_MAX)
+		return ERR_UNSUPPORTED;
+
+	earth_cache.size = entries;
+	earth_cache.count = 0;
+	earth_cache.hits = 0;
+	earth_cache.misses = 0;
+	return SUCCESS;
+}
+
+/*
+ * Returns the counters of the Earth cache of the calling thread since it was
+ * last set up with vsop87_earth_cache().
+ *
+ * hits -- The number of calculations answered from the cache.
+ * misses -- The number of calculations that had to be done.
+ */
+void vsop87_earth_cache_stats(unsigned long *hits, unsigned long *misses)
+{
+	*hits = earth_cache.hits;
+	*misses = earth_cache.misses;
+}
+
+/*
+ * Calculates a major planet's heliocentric rectangular coordinates using the
+ * VSOP87 (version A) theory in its entirety.
+ *
+ * planet -- Enumeration that identifies the planet for calculations.
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * pos -- The planet's heliocentric rectangular coordinates in AU. The reference
+ *        frame is the equinox & ecliptic of J2000.
+ *
+ * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ *         ERR_INVALID_PLANET -- If the planet's identifier is invalid.
+ */
+int vsop87_coordinates(enum solar_system_planets planet, struct julian_date *tdb,
+		struct rectangular_coordinates *pos)
+{
+	if (planet == EARTH && earth_cache.size) {
+		earth_cached(tdb, pos, NULL);
+		return SUCCESS;
+	}
+
+	return vsop87_coordinates_batch(planet, tdb, 1, pos);
+}
+
+/*
+ * Calculates a major planet's heliocentric rectangular coordinates at a
+ * number of epochs using the VSOP87 (version A) theory in its entirety. The
+ * epochs are processed in blocks of VSOP87_BLOCK_SIZE, and every term of the
+ * theory is read once per block rather than once per epoch.
+ *
+ * planet -- Enumeration that identifies the planet for calculations.
+ * tdb -- Array of n TDBs to be used for calculations. TT may be used for all
+ *        but the most exacting applications.
+ * n -- The number of epochs in tdb.
+ * pos -- Array of n elements that will contain the planet's heliocentric
+ *        rectangular coordinates in AU. The reference frame is the equinox &
+ *        ecliptic of J2000.
+ *
+ * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ *         ERR_INVALID_PLANET -- If the planet's identifier is invalid.
+ */
+int vsop87_coordinates_batch(enum solar_system_planets planet,
+		const struct julian_date *tdb, size_t n,
+		struct rectangular_coordinates *pos)
+{
+	int i,j,l,m,w;
+	size_t k;
+	struct series_kernel *kernel;
+	struct factored_planet *fp;
+	struct planet_epoch epoch;
+	double t[VSOP87_BLOCK_SIZE],sum[PLANET_SERIES_COUNT][VSOP87_BLOCK_SIZE],
+		x[MAX_FREQUENCIES],sn[MAX_FREQUENCIES],cs[MAX_FREQUENCIES],
+		whole[FACTORED_PADDING],frac[FACTORED_PADDING],
+		sw[FACTORED_PADDING],gs[PLANET_SERIES_COUNT],*block;
+
+	if (planet < MERCURY || planet > NEPTUNE)
+		return ERR_INVALID_PLANET;
+
+	/* The scalar kernel always sums up the original terms */
+	kernel = &series_kernels[current_kernel];
+	fp = kernel->factored_sum && !kernel->generated ?
+		get_factored(planet) : NULL;
+
+	/* Sines & cosines for several epochs at once, when there are any */
+	block = NULL;
+	if (fp && kernel->factored_block && n > 1)
+		block = malloc(3 * fp->freq_count * kernel->width * sizeof(double));
+
+	for (k = 0; k < n; k += m) {
+		m = (n - k < VSOP87_BLOCK_SIZE) ? n - k : VSOP87_BLOCK_SIZE;
+		for (j = 0; j < m; j++)
+			t[j] = JULIAN_MILLENNIA(tdb[k + j].date1, tdb[k + j].date2);
+		memset(sum, 0, sizeof(sum));
+
+		if (kernel->generated) {
+			for (j = 0; j < m; j++) {
+				set_epoch(&tdb[k + j], &epoch);
+				generated_sums(kernel, planet, &epoch, gs);
+				for (i = 0; i < PLANET_SERIES_COUNT; i++)
+					sum[i][j] = gs[i];
+			}
+		} else if (fp && block) {
+			/*
+			 * Calculate sin(c*t) and cos(c*t) once for every unique
+			 * frequency, for as many epochs as there are lanes, and
+			 * apply each factored term to all of them. The last
+			 * epoch is repeated to fill up the final group.
+			 */
+			w = kernel->width;
+			for (j = 0; j < m; j += w) {
+				for (l = 0; l < w; l++)
+					reduction_days(&tdb[k + (j + l < m ? j + l :
+						m - 1)], &whole[l], &frac[l]);
+				kernel->reduce_block(fp->rate_hi, fp->rate_lo,
+					fp->freq_count, whole, frac, w,
+					block + 2 * fp->freq_count * w);
+				kernel->sincos_table(block + 2 * fp->freq_count * w,
+					fp->freq_count * w, block,
+					block + fp->freq_count * w);
+				for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+					kernel->factored_block(fp->ac[i], fp->as[i],
+						fp->f[i], fp->count[i], block,
+						block + fp->freq_count * w, sw);
+					for (l = 0; l < w && j + l < m; l++)
+						sum[i][j + l] = sw[l];
+				}
+			}
+		} else if (fp) {
+			/*
+			 * Calculate sin(c*t) and cos(c*t) once for every unique
+			 * frequency and use them for all the factored terms.
+			 */
+			for (j = 0; j < m; j++) {
+				reduce_frequencies(kernel, fp->rate_hi,
+					fp->rate_lo, fp->freq_count, &tdb[k + j], x);
+				kernel->sincos_table(x, fp->freq_count, sn, cs);
+				for (i = 0; i < PLANET_SERIES_COUNT; i++)
+					sum[i][j] = kernel->factored_sum(fp->ac[i],
+						fp->as[i], fp->f[i], fp->count[i],
+						sn, cs);
+			}
+		} else {
+			/*
+			 * Sum up the terms a*cos(b + c*t) for each series
+			 * x0,y0,z0... Each term is applied to every epoch in the
+			 * block before moving on to the next one.
+			 */
+			for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+				kernel->series_sum(
+					&planets_series[planet * PLANET_SERIES_COUNT + i],
+					t, m, sum[i]);
+			}
+		}
+
+		for (j = 0; j < m; j++)
+			series_to_position(&sum[0][j], VSOP87_BLOCK_SIZE, t[j],
+				&pos[k + j]);
+	}
+
+	free(block);
+	return SUCCESS;
+}
 
 /*
- * Calculates a major planet's heliocentric rectangular coordinates using the
- * VSOP87 (version A) theory in its entirety.
+ * Calculates the sines and cosines of a table of arguments in single
+ * precision, one at a time with sinf() and cosf() from the C library.
+ *
+ * x -- The arguments, from reduce_frequencies().
+ * n -- The number of arguments in x.
+ * sn -- The sines, n elements.
+ * cs -- The cosines, n elements.
+ */
+static void sincos_table_f_scalar(const double *x, int n, float *sn,
+		float *cs)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		sn[i] = sinf(x[i]);
+		cs[i] = cosf(x[i]);
+	}
+}
+
+/*
+ * Sums up a factored series in single precision, one term at a time from
+ * the end of the series.
+ *
+ * ac, as, f, n -- The single precision factored series.
+ * sn, cs -- sin(c*t) and cos(c*t) for each frequency.
+ *
+ * Return: The sum of the series.
+ */
+static double factored_sum_f_scalar(const float *ac, const float *as,
+		const int *f, int n, const float *sn, const float *cs)
+{
+	int j;
+	float sum;
+
+	sum = 0;
+	for (j = n - 1; j >= 0; j--)
+		sum += ac[j] * cs[f[j]] - as[j] * sn[f[j]];
+
+	return sum;
+}
+
+/*
+ * Calculates a major planet's heliocentric rectangular coordinates at a
+ * number of epochs using the VSOP87 (version A) theory in single precision.
+ * The sines, cosines & sums of the terms are calculated with floats, in
+ * vectors with twice as many lanes as vsop87_coordinates_batch(). The
+ * epochs, the reduction of the arguments c*t and the final polynomials in t
+ * stay in double precision, so the accuracy does not degrade far from J2000.
+ * The largest differences from vsop87_coordinates() within 4000 years of
+ * J2000 are listed in vsop87.h.
+ *
+ * planet -- Enumeration that identifies the planet for calculations.
+ * tdb -- Array of n TDBs to be used for calculations. TT may be used for all
+ *        but the most exacting applications.
+ * n -- The number of epochs in tdb.
+ * pos -- Array of n elements that will contain the planet's heliocentric
+ *        rectangular coordinates in AU. The reference frame is the equinox &
+ *        ecliptic of J2000.
+ *
+ * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ *         ERR_INVALID_PLANET -- If the planet's identifier is invalid.
+ */
+int vsop87_coordinates_fast(enum solar_system_planets planet,
+		const struct julian_date *tdb, size_t n,
+		struct rectangular_coordinates *pos)
+{
+	int i,j,l,m,w;
+	size_t k;
+	struct series_kernel *kernel;
+	struct factored_planet *fp;
+	struct fast_planet *xp;
+	double t[VSOP87_BLOCK_SIZE],sum[PLANET_SERIES_COUNT][VSOP87_BLOCK_SIZE],
+		x[MAX_FREQUENCIES],whole[FACTORED_PADDING],frac[FACTORED_PADDING],
+		sw[FACTORED_PADDING],*reduced;
+	float sn[MAX_FREQUENCIES],cs[MAX_FREQUENCIES],*block;
+
+	if (planet < MERCURY || planet > NEPTUNE)
+		return ERR_INVALID_PLANET;
+
+	fp = get_factored(planet);
+	xp = fp ? get_fast(planet, fp) : NULL;
+	if (!xp)
+		return vsop87_coordinates_batch(planet, tdb, n, pos);
+
+	/* Sines & cosines for several epochs at once, when there are any */
+	kernel = &series_kernels[current_kernel];
+	w = 2 * kernel->width;
+	block = NULL;
+	reduced = NULL;
+	if (kernel->factored_block_f && n > 1) {
+		reduced = malloc(fp->freq_count * w *
+			(sizeof(double) + 2 * sizeof(float)));
+		if (reduced)
+			block = (float *)(reduced + fp->freq_count * w);
+	}
+
+	for (k = 0; k < n; k += m) {
+		m = (n - k < VSOP87_BLOCK_SIZE) ? n - k : VSOP87_BLOCK_SIZE;
+		for (j = 0; j < m; j++)
+			t[j] = JULIAN_MILLENNIA(tdb[k + j].date1, tdb[k + j].date2);
+
+		if (block) {
+			/* As in vsop87_coordinates_batch() */
+			for (j = 0; j < m; j += w) {
+				for (l = 0; l < w; l++)
+					reduction_days(&tdb[k + (j + l < m ? j + l :
+						m - 1)], &whole[l], &frac[l]);
+				kernel->reduce_block(fp->rate_hi, fp->rate_lo,
+					fp->freq_count, whole, frac, w, reduced);
+				kernel->sincos_table_f(reduced, fp->freq_count * w,
+					block, block + fp->freq_count * w);
+				for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+					kernel->factored_block_f(xp->ac[i], xp->as[i],
+						fp->f[i], fp->count[i], block,
+						block + fp->freq_count * w, sw);
+					for (l = 0; l < w && j + l < m; l++)
+						sum[i][j + l] = sw[l];
+				}
+			}
+		} else {
+			for (j = 0; j < m; j++) {
+				reduce_frequencies(kernel, fp->rate_hi,
+					fp->rate_lo, fp->freq_count, &tdb[k + j], x);
+				if (kernel->sincos_table_f)
+					kernel->sincos_table_f(x, fp->freq_count, sn,
+						cs);
+				else
+					sincos_table_f_scalar(x, fp->freq_count, sn,
+						cs);
+				for (i = 0; i < PLANET_SERIES_COUNT; i++) {
+					if (kernel->factored_sum_f)
+						sum[i][j] = kernel->factored_sum_f(
+							xp->ac[i], xp->as[i], fp->f[i],
+							fp->count[i], sn, cs);
+					else
+						sum[i][j] = factored_sum_f_scalar(
+							xp->ac[i], xp->as[i], fp->f[i],
+							fp->count[i], sn, cs);
+				}
+			}
+		}
+
+		for (j = 0; j < m; j++)
+			series_to_position(&sum[0][j], VSOP87_BLOCK_SIZE, t[j],
+				&pos[k + j]);
+	}
+
+	free(reduced);
+	return SUCCESS;
+}
+
+/*
+ * Calculates a major planet's heliocentric position and velocity using the
+ * VSOP87 (version A) theory in its entirety. The velocity is the analytic
+ * derivative of the series, accumulated in the same pass over the terms as
+ * the position.
  *
  * planet -- Enumeration that identifies the planet for calculations.
  * tdb -- TDB to be used for calculations. TT may be used for all but the most
  *        exacting applications.
  * pos -- The planet's heliocentric rectangular coordinates in AU. The reference
  *        frame is the equinox & ecliptic of J2000.
+ * vel -- The planet's heliocentric velocity in AU/day, in the same frame.
  *
- * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ * Return: SUCCESS -- If the state has been calculated successfully.
  *         ERR_INVALID_PLANET -- If the planet's identifier is invalid.
  */
-int vsop87_coordinates(enum solar_system_planets planet, struct julian_date *tdb,
-		struct rectangular_coordinates *pos)
+int vsop87_state(enum solar_system_planets planet, struct julian_date *tdb,
+		struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel)
+{
+	struct planet_epoch epoch;
+
+	if (planet < MERCURY || planet > NEPTUNE)
+		return ERR_INVALID_PLANET;
+
+	if (planet == EARTH && earth_cache.size) {
+		earth_cached(tdb, pos, vel);
+		return SUCCESS;
+	}
+
+	set_epoch(tdb, &epoch);
+	planet_state(planet, &epoch, pos, vel);
+	return SUCCESS;
+}
+
+/*
+ * Calculates a major planet's astrometric geocentric position, corrected
+ * for light-time. The planet's state and the Earth's position are
+ * calculated once, at tdb. The light-time equation is then solved with the
+ * planet's motion predicted by a second order Taylor series, with its
+ * velocity from the theory and the acceleration of its Keplerian orbit.
+ * If the error of the prediction could exceed VSOP87_LIGHT_TIME_TOLERANCE,
+ * the planet is calculated once more at the retarded epoch and the small
+ * remaining change in the light-time is applied with its velocity.
+ *
+ * planet -- Enumeration that identifies the planet for calculations. It
+ *           may not be EARTH.
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * pos -- The planet's position at tdb less the light-time, relative to the
+ *        Earth's position at tdb, in AU. The reference frame is the equinox &
+ *        ecliptic of J2000. Aberration and nutation are not applied.
+ * dist -- If not NULL, the planet's geocentric distance in AU, i.e. the
+ *         light-time times C_AUPERDAY.
+ *
+ * Return: SUCCESS -- If the position has been calculated successfully.
+ *         ERR_INVALID_PLANET -- If the planet's identifier is invalid.
+ */
+int vsop87_geocentric_apparent(enum solar_system_planets planet,
+		struct julian_date *tdb, struct rectangular_coordinates *pos,
+		double *dist)
 {
 	int i;
-	struct vsop87_term *p;
-	double t,sum[PLANET_SERIES_COUNT],xyz[3];
+	double r,k,jerk,tau,d,err;
+	struct rectangular_coordinates pla,vel,ear,ret;
+	struct julian_date t;
+	struct planet_epoch epoch;
+
+	if (planet < MERCURY || planet > NEPTUNE || planet == EARTH)
+		return ERR_INVALID_PLANET;
+
+	set_epoch(tdb, &epoch);
+	planet_state(planet, &epoch, &pla, &vel);
+	vsop87_coordinates(EARTH, tdb, &ear);
+
+	/* Acceleration -k*pla and bound on the jerk of the Keplerian orbit */
+	r = sqrt(pla.x * pla.x + pla.y * pla.y + pla.z * pla.z);
+	k = GAUSS_GRAV_CONSTANT * GAUSS_GRAV_CONSTANT / (r * r * r);
+	jerk = 4 * k * sqrt(vel.x * vel.x + vel.y * vel.y + vel.z * vel.z);
+
+	/* The iteration contracts by |vel|/C_AUPERDAY, well below 1E-3 */
+	tau = 0;
+	for (i = 0; i < 8; i++) {
+		ret.x = pla.x - tau * (vel.x + tau * k * pla.x / 2) - ear.x;
+		ret.y = pla.y - tau * (vel.y + tau * k * pla.y / 2) - ear.y;
+		ret.z = pla.z - tau * (vel.z + tau * k * pla.z / 2) - ear.z;
+		d = sqrt(ret.x * ret.x + ret.y * ret.y + ret.z * ret.z);
+		if (fabs(d / C_AUPERDAY - tau) < 1E-13) {
+			tau = d / C_AUPERDAY;
+			break;
+		}
+		tau = d / C_AUPERDAY;
+	}
+
+	/* Bound on the acceleration & jerk left out of the prediction */
+	err = tau * tau * (VSOP87_LIGHT_TIME_PERTURBATION / 2 + jerk * tau / 6);
+	if (err > VSOP87_LIGHT_TIME_TOLERANCE) {
+		t = *tdb;
+		t.date2 -= tau;
+		set_epoch(&t, &epoch);
+		planet_state(planet, &epoch, &pla, NULL);
+		ret.x = pla.x - ear.x;
+		ret.y = pla.y - ear.y;
+		ret.z = pla.z - ear.z;
+		d = sqrt(ret.x * ret.x + ret.y * ret.y + ret.z * ret.z);
+
+		/* Move by the change in the light-time, of order err/C_AUPERDAY */
+		tau -= d / C_AUPERDAY;
+		ret.x += tau * vel.x;
+		ret.y += tau * vel.y;
+		ret.z += tau * vel.z;
+		d = sqrt(ret.x * ret.x + ret.y * ret.y + ret.z * ret.z);
+	}
+
+	*pos = ret;
+	if (dist)
+		*dist = d;
+
+	return SUCCESS;
+}
+
+/* Arguments of snapshot_worker() */
+struct snapshot_work {
+	const struct planet_epoch *epoch;
+	unsigned int planets;
+	int first;
+	int stride;
+	int velocity;
+	struct vsop87_snapshot *snap;
+};
+
+/*
+ * Calculates every stride'th planet in a snapshot, starting at first.
+ *
+ * arg -- The struct snapshot_work describing the planets.
+ *
+ * Return: NULL.
+ */
+static void *snapshot_worker(void *arg)
+{
+	int i,j;
+	struct snapshot_work *work = arg;
+
+	for (i = MERCURY, j = 0; i <= NEPTUNE; i++) {
+		if (!(work->planets & VSOP87_PLANET_MASK(i)))
+			continue;
+		if (j++ % work->stride == work->first)
+			planet_state(i, work->epoch, &work->snap->pos[i],
+				work->velocity ? &work->snap->vel[i] : NULL);
+	}
+
+	return NULL;
+}
+
+/*
+ * Calculates the heliocentric coordinates of the Earth and a number of
+ * other major planets at one epoch using the VSOP87 (version A) theory in
+ * its entirety. The Earth is always calculated, so that callers working
+ * with geocentric positions need not calculate it again for every body.
+ * The time and the split of the epoch for the reduction of the arguments
+ * are worked out once for all the planets.
+ *
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * planets -- The planets to be calculated, as a combination of
+ *            VSOP87_PLANET_MASK() or VSOP87_ALL_PLANETS.
+ * flags -- VSOP87_SNAPSHOT_VELOCITY to calculate velocities as well, and
+ *          VSOP87_SNAPSHOT_THREADS to calculate the planets in parallel.
+ *          The threads are started and joined on every call. Starting one
+ *          costs about as much as calculating two planets, so this only
+ *          pays off with velocities or most of the planets, and several
+ *          CPUs.
+ * snap -- The positions, and velocities if requested, of the planets. The
+ *         reference frame is the equinox & ecliptic of J2000. Entries of
+ *         planets that were not requested are left untouched.
+ *
+ * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ *         ERR_INVALID_PLANET -- If planets has bits for unknown planets.
+ */
+int vsop87_snapshot(struct julian_date *tdb, unsigned int planets, int flags,
+		struct vsop87_snapshot *snap)
+{
+	int i,count,threads;
+	long cpus;
+	pthread_t tid[NEPTUNE + 1];
+	struct snapshot_work work[NEPTUNE + 1];
+	struct planet_epoch epoch;
+
+	if (planets & ~VSOP87_ALL_PLANETS)
+		return ERR_INVALID_PLANET;
+
+	planets |= VSOP87_PLANET_MASK(EARTH);
+	snap->tdb = *tdb;
+	snap->planets = planets;
+	snap->flags = flags;
+
+	for (i = MERCURY, count = 0; i <= NEPTUNE; i++) {
+		if (planets & VSOP87_PLANET_MASK(i))
+			count++;
+	}
+
+	threads = 1;
+	if (flags & VSOP87_SNAPSHOT_THREADS) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus < count) ? cpus : count;
+		if (threads < 1)
+			threads = 1;
+	}
+
+	/* t is worked out once and shared by all the planets and threads */
+	set_epoch(tdb, &epoch);
+	for (i = 0; i < threads; i++) {
+		work[i].epoch = &epoch;
+		work[i].planets = planets;
+		work[i].first = i;
+		work[i].stride = threads;
+		work[i].velocity = flags & VSOP87_SNAPSHOT_VELOCITY;
+		work[i].snap = snap;
+	}
+
+	/* The calling thread takes the first share, and any that failed */
+	for (i = 1; i < threads; i++) {
+		if (pthread_create(&tid[i], NULL, snapshot_worker, &work[i]))
+			work[i].stride = 0;
+	}
+	snapshot_worker(&work[0]);
+	for (i = 1; i < threads; i++) {
+		if (work[i].stride)
+			pthread_join(tid[i], NULL);
+		else {
+			work[i].stride = threads;
+			snapshot_worker(&work[i]);
+		}
+	}
+
+	return SUCCESS;
+}
+
+/*
+ * Calculates a major planet's heliocentric rectangular coordinates using a
+ * truncated form of the VSOP87 (version A) theory. Each series x0..z5 is
+ * summed in order of decreasing amplitude, and the remaining terms are
+ * dropped once the sum of their amplitudes times |t|^k falls below
+ * tolerance/6. The error in each coordinate is therefore bounded by the
+ * tolerance, on top of the truncation error of the full theory.
+ *
+ * planet -- Enumeration that identifies the planet for calculations.
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * tolerance -- The largest error in AU that is acceptable in each coordinate.
+ * pos -- The planet's heliocentric rectangular coordinates in AU. The reference
+ *        frame is the equinox & ecliptic of J2000.
+ * bound -- If not NULL, the bound on the error in AU that was achieved. It is
+ *          the largest over x, y, z of the sum of the dropped amplitudes
+ *          times |t|^k, and is never more than tolerance.
+ *
+ * Return: SUCCESS -- If the coordinates have been calculated successfully.
+ *         ERR_INVALID_PLANET -- If the planet's identifier is invalid.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated.
+ */
+int vsop87_coordinates_tol(enum solar_system_planets planet,
+		struct julian_date *tdb, double tolerance,
+		struct rectangular_coordinates *pos, double *bound)
+{
+	int i,j,k,lo,hi,used,count[PLANET_SERIES_COUNT];
+	struct series_kernel *kernel;
+	struct sorted_planet *sp;
+	double t,tk,limit,err[3],sum[PLANET_SERIES_COUNT];
+	double x[MAX_FREQUENCIES],sn[MAX_FREQUENCIES],cs[MAX_FREQUENCIES];
 
 	if (planet < MERCURY || planet > NEPTUNE)
 		return ERR_INVALID_PLANET;
 
+	sp = get_sorted(planet);
+	if (!sp)
+		return ERR_UNSUPPORTED;
+
+	kernel = &series_kernels[current_kernel];
 	t = JULIAN_MILLENNIA(tdb->date1, tdb->date2);
-	memset(sum, 0, sizeof(sum));
+	memset(err, 0, sizeof(err));
 
-	/* Sum up the terms a*cos(b + c*t) for each series x0,y0,z0... */
+	tk = 1;
+	used = 0;
 	for (i = 0; i < PLANET_SERIES_COUNT; i++) {
-		p = planets_terms[planet * PLANET_SERIES_COUNT + i];
-		while (p->a != 0 || p->b != 0 || p->c != 0) {
-			sum[i] += (p->a * cos(p->b + p->c * t));
-			p++;
+		/* Find the fewest terms whose tail is within the budget */
+		tk = i % 6 ? tk * fabs(t) : 1;
+		limit = tk > 0 ? tolerance / (6 * tk) : HUGE_VAL;
+		lo = 0;
+		hi = factored[planet].count[i];
+		while (lo < hi) {
+			k = (lo + hi) / 2;
+			if (sp->tail[i][k] <= limit)
+				hi = k;
+			else
+				lo = k + 1;
 		}
+
+		/* Keep whole groups of terms for the kernels */
+		count[i] = (lo + FACTORED_PADDING - 1) / FACTORED_PADDING *
+			FACTORED_PADDING;
+		err[i / 6] += sp->tail[i][count[i]] * tk;
+		if (sp->reach[i][count[i]] > used)
+			used = sp->reach[i][count[i]];
 	}
 
-	for (i = 0; i < PLANET_SERIES_COUNT; i += 6) {
-		xyz[i / 6] = sum[i] +
-			(sum[i + 1] +
-			(sum[i + 2] +
-			(sum[i + 3] +
-			(sum[i + 4] + sum[i + 5] * t) * t) * t) * t) * t;
+	/* Only the leading frequencies are referred to by the kept terms */
+	used = (used + FACTORED_PADDING - 1) / FACTORED_PADDING *
+		FACTORED_PADDING;
+	reduce_frequencies(kernel, sp->rate_hi, sp->rate_lo, used, tdb, x);
+	if (kernel->sincos_table) {
+		kernel->sincos_table(x, used, sn, cs);
+	} else {
+		for (j = 0; j < used; j++)
+			sincos(x[j], &sn[j], &cs[j]);
 	}
 
-	pos->x = xyz[0];
-	pos->y = xyz[1];
-	pos->z = xyz[2];
+	for (i = 0; i < PLANET_SERIES_COUNT; i++)
+		sum[i] = sum_factored(kernel, sp->ac[i], sp->as[i], sp->f[i],
+			count[i], sn, cs);
+
+	series_to_position(sum, 1, t, pos);
+	if (bound)
+		*bound = fmax(err[0], fmax(err[1], err[2]));
 
 	return SUCCESS;
 }
@@ -97,3 +1763,328 @@ void vsop87_ecliptic_to_equator(struct rectangular_coordinates *pos)
 
 	rotate_rectangular(rot_matrix, pos);
 }
+
+/*
+ * Calculates sin(c*t) and cos(c*t) afresh for every unique frequency at the
+ * stepper's current epoch.
+ *
+ * st -- The stepper to be seeded.
+ */
+static void seed_stepper(struct vsop87_stepper *st)
+{
+	int i;
+	double whole,frac;
+	struct julian_date tdb;
+	struct factored_planet *fp = &factored[st->planet];
+
+	tdb.date1 = st->tdb.date1;
+	tdb.date2 = st->tdb.date2 + st->count * st->step;
+	reduction_days(&tdb, &whole, &frac);
+	for (i = 0; i < st->freq_count; i++)
+		sincos(reduce_argument(fp->rate_hi[i], fp->rate_lo[i], whole,
+			frac), &st->sn[i], &st->cs[i]);
+}
+
+/*
+ * Prepares to calculate a major planet's heliocentric rectangular
+ * coordinates with the VSOP87 (version A) theory on a uniform grid of
+ * epochs. The stepper keeps sin(c*t) and cos(c*t) for every unique
+ * frequency in the theory and advances them by a rotation through c*step,
+ * so that no trigonometric functions are evaluated from one step to the
+ * next. They are calculated afresh every VSOP87_STEPPER_RESEED steps to
+ * bound the drift. The coordinates agree with vsop87_coordinates() to within
+ * VSOP87_STEPPER_TOLERANCE AU.
+ *
+ * st -- The stepper. Must be released with vsop87_stepper_free().
+ * planet -- Enumeration that identifies the planet for calculations.
+ * tdb -- The first epoch. TDB to be used for calculations. TT may be used
+ *        for all but the most exacting applications.
+ * step -- The interval between consecutive epochs in days.
+ *
+ * Return: SUCCESS -- If the stepper has been initialized.
+ *         ERR_INVALID_PLANET -- If the planet's identifier is invalid.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated.
+ */
+int vsop87_stepper_init(struct vsop87_stepper *st,
+		enum solar_system_planets planet, struct julian_date *tdb,
+		double step)
+{
+	int i;
+	double dt;
+	struct factored_planet *fp;
+
+	if (planet < MERCURY || planet > NEPTUNE)
+		return ERR_INVALID_PLANET;
+
+	fp = get_factored(planet);
+	if (!fp)
+		return ERR_UNSUPPORTED;
+
+	st->planet = planet;
+	st->tdb = *tdb;
+	st->step = step;
+	st->count = 0;
+	st->freq_count = fp->freq_count;
+	st->sn = malloc(4 * fp->freq_count * sizeof(double));
+	if (!st->sn)
+		return ERR_UNSUPPORTED;
+	st->cs = st->sn + fp->freq_count;
+	st->sd = st->cs + fp->freq_count;
+	st->cd = st->sd + fp->freq_count;
+
+	dt = step / JULIAN_MILLENNIUM_LENGTH;
+	for (i = 0; i < fp->freq_count; i++)
+		sincos(fp->freq[i] * dt, &st->sd[i], &st->cd[i]);
+
+	seed_stepper(st);
+	return SUCCESS;
+}
+
+/*
+ * Calculates a major planet's coordinates at the stepper's current epoch and
+ * advances the stepper to the next epoch. The first call returns the
+ * coordinates at the epoch passed to vsop87_stepper_init().
+ *
+ * st -- The stepper.
+ * pos -- The planet's heliocentric rectangular coordinates in AU. The
+ *        reference frame is the equinox & ecliptic of J2000.
+ */
+void vsop87_stepper_next(struct vsop87_stepper *st,
+		struct rectangular_coordinates *pos)
+{
+	int i;
+	double t,s,sum[PLANET_SERIES_COUNT];
+	struct factored_planet *fp = &factored[st->planet];
+	struct series_kernel *kernel = &series_kernels[current_kernel];
+
+	t = JULIAN_MILLENNIA(st->tdb.date1, st->tdb.date2 + st->count * st->step);
+
+	for (i = 0; i < PLANET_SERIES_COUNT; i++)
+		sum[i] = sum_factored(kernel, fp->ac[i], fp->as[i], fp->f[i],
+			fp->count[i], st->sn, st->cs);
+	series_to_position(sum, 1, t, pos);
+
+	/* Rotate every (cos, sin) pair through c*step */
+	st->count++;
+	if (st->count % VSOP87_STEPPER_RESEED == 0) {
+		seed_stepper(st);
+	} else {
+		for (i = 0; i < st->freq_count; i++) {
+			s = st->sn[i] * st->cd[i] + st->cs[i] * st->sd[i];
+			st->cs[i] = st->cs[i] * st->cd[i] - st->sn[i] * st->sd[i];
+			st->sn[i] = s;
+		}
+	}
+}
+
+/*
+ * Releases the memory held by a stepper.
+ *
+ * st -- The stepper initialized by vsop87_stepper_init().
+ */
+void vsop87_stepper_free(struct vsop87_stepper *st)
+{
+	free(st->sn);
+	st->sn = NULL;
+}
+
+/*
+ * Checks that a series in a binary table file lies within the file and is
+ * suitably aligned and padded for the kernels.
+ *
+ * fs -- The series in the file header.
+ * size -- The size of the file.
+ *
+ * Return: 1 -- If the series is valid.
+ *         0 -- If it is not.
+ */
+static int valid_file_series(const struct vsop87_file_series *fs, size_t size)
+{
+	if (fs->count == 0)
+		return fs->padded == 0;
+
+	return fs->count > 0 && fs->padded >= fs->count &&
+		fs->padded % VSOP87_TERM_PADDING == 0 &&
+		fs->offset >= (int64_t)sizeof(struct vsop87_file_header) &&
+		fs->offset % VSOP87_TERM_ALIGNMENT == 0 &&
+		(uint64_t)fs->offset + 3 * (uint64_t)fs->padded * sizeof(double)
+			<= size;
+}
+
+/*
+ * Maps a binary table of the VSOP87 theory into memory. Any version of the
+ * theory may be loaded, and its series are summed up by the same kernels as
+ * the built-in VSOP87 (version A) tables. Since the file is mapped read-only,
+ * every process that loads it shares a single copy of its pages.
+ *
+ * path -- The table file, created by examples/vsop87_convert from the
+ *         original files of the theory.
+ * version -- The version of the theory expected in the file, 'A' to 'E', or
+ *            0 to accept any version.
+ * table -- The loaded table. Must be released with vsop87_unload().
+ *
+ * Return: SUCCESS -- If the table has been loaded.
+ *         ERR_FILE_ACCESS -- If the file could not be opened or mapped.
+ *         ERR_INVALID_DATA -- If the file is not a table of the version
+ *                             requested in the format of this library.
+ *         ERR_UNSUPPORTED -- If memory could not be allocated or the
+ *                            platform cannot map files.
+ */
+int vsop87_load(const char *path, char version, struct vsop87_table **table)
+{
+#ifndef _WIN32
+	int i,j,fd;
+	struct stat st;
+	struct vsop87_table *tbl;
+	const struct vsop87_file_header *hdr;
+	const struct vsop87_file_series *fs;
+	const char *base;
+	void *map;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return ERR_FILE_ACCESS;
+
+	if (fstat(fd, &st)) {
+		close(fd);
+		return ERR_FILE_ACCESS;
+	}
+	if (st.st_size < (off_t)sizeof(*hdr)) {
+		close(fd);
+		return ERR_INVALID_DATA;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return ERR_FILE_ACCESS;
+
+	hdr = map;
+	base = map;
+	if (memcmp(hdr->magic, VSOP87_FILE_MAGIC, sizeof(VSOP87_FILE_MAGIC)) ||
+		hdr->format != VSOP87_FILE_FORMAT ||
+		hdr->byte_order != VSOP87_FILE_BYTE_ORDER ||
+		hdr->version < 'A' || hdr->version > 'E' ||
+		(version && hdr->version != version) ||
+		(hdr->bodies & ~((1 << VSOP87_BODY_COUNT) - 1))) {
+		munmap(map, st.st_size);
+		return ERR_INVALID_DATA;
+	}
+
+	tbl = calloc(1, sizeof(*tbl));
+	if (tbl)
+		tbl->factored = calloc(VSOP87_BODY_COUNT,
+					sizeof(struct factored_planet));
+	if (!tbl || !tbl->factored) {
+		free(tbl);
+		munmap(map, st.st_size);
+		return ERR_UNSUPPORTED;
+	}
+
+	tbl->version = hdr->version;
+	tbl->bodies = hdr->bodies;
+	tbl->map = map;
+	tbl->size = st.st_size;
+	for (i = 0; i < VSOP87_BODY_COUNT; i++) {
+		if (!(tbl->bodies & (1 << i)))
+			continue;
+
+		for (j = 0; j < VSOP87_SERIES_PER_BODY; j++) {
+			fs = &hdr->series[i][j];
+			if (!valid_file_series(fs, tbl->size)) {
+				vsop87_unload(tbl);
+				return ERR_INVALID_DATA;
+			}
+
+			tbl->series[i][j].count = fs->count;
+			if (fs->count) {
+				tbl->series[i][j].a = (const double *)(base + fs->offset);
+				tbl->series[i][j].b = tbl->series[i][j].a + fs->padded;
+				tbl->series[i][j].c = tbl->series[i][j].b + fs->padded;
+			}
+		}
+	}
+
+	*table = tbl;
+	return SUCCESS;
+#else
+	return ERR_UNSUPPORTED;
+#endif
+}
+
+/*
+ * Calculates the variables of a body, and optionally their rates of change,
+ * from a table loaded by vsop87_load(). The variables depend on the version
+ * of the theory:
+ *
+ * A -- Heliocentric x, y, z in AU. Ecliptic & equinox of J2000.
+ * B -- Heliocentric L, B in radians & R in AU. Ecliptic & equinox of J2000.
+ * C -- Heliocentric x, y, z in AU. Ecliptic & equinox of date.
+ * D -- Heliocentric L, B in radians & R in AU. Ecliptic & equinox of date.
+ * E -- Barycentric x, y, z in AU. Ecliptic & equinox of J2000.
+ *
+ * L is reduced to the range [0, 2*PI).
+ *
+ * table -- The table from vsop87_load().
+ * body -- A planet from enum solar_system_planets, VSOP87_EMB or VSOP87_SUN.
+ * tdb -- TDB to be used for calculations. TT may be used for all but the most
+ *        exacting applications.
+ * var -- The three variables of the body.
+ * rate -- If not NULL, the rates of change of the variables per day.
+ *
+ * Return: SUCCESS -- If the variables have been calculated successfully.
+ *         ERR_INVALID_PLANET -- If the body is not present in the table.
+ */
+int vsop87_table_state(struct vsop87_table *table, int body,
+		struct julian_date *tdb, double var[3], double rate[3])
+{
+	struct rectangular_coordinates pos,vel;
+	struct planet_epoch epoch;
+
+	if (body < 0 || body >= VSOP87_BODY_COUNT ||
+		!(table->bodies & (1 << body)))
+		return ERR_INVALID_PLANET;
+
+	set_epoch(tdb, &epoch);
+	series_state(table->series[body],
+		(struct factored_planet *)table->factored + body, &epoch, &pos,
+		rate ? &vel : NULL);
+
+	var[0] = pos.x;
+	var[1] = pos.y;
+	var[2] = pos.z;
+	if (table->version == 'B' || table->version == 'D') {
+		var[0] = fmod(var[0], TWO_PI);
+		if (var[0] < 0)
+			var[0] += TWO_PI;
+	}
+
+	if (rate) {
+		rate[0] = vel.x;
+		rate[1] = vel.y;
+		rate[2] = vel.z;
+	}
+
+	return SUCCESS;
+}
+
+/*
+ * Unmaps a table loaded by vsop87_load() and releases its memory.
+ *
+ * table -- The table from vsop87_load().
+ */
+void vsop87_unload(struct vsop87_table *table)
+{
+	int i;
+	struct factored_planet *fp = table->factored;
+
+#ifndef _WIN32
+	munmap(table->map, table->size);
+#endif
+	for (i = 0; i < VSOP87_BODY_COUNT; i++) {
+		if (fp[i].ready > 0)
+			free(fp[i].mem);
+	}
+	free(fp);
+	free(table);
+}
@@ -19,20 +19,238 @@
 #ifndef _VSOP87_H_
 #define _VSOP87_H_
 
+#include <stdint.h>
+#include <stddef.h>
 #include <kepler.h>
 #include <julian_date.h>
 #include <coordinates.h>
 
-/* Used internally to store the series of terms in the theory */
-struct vsop87_term {
-	double a;
-	double b;
-	double c;
+/* Number of epochs processed together by vsop87_coordinates_batch() */
+#define VSOP87_BLOCK_SIZE	64
+
+/*
+ * Largest difference in AU between the coordinates computed by the
+ * vectorized kernels and VSOP87_KERNEL_SCALAR within 4000 years of J2000.
+ * Most of it comes from the rounding of c*t in VSOP87_KERNEL_SCALAR. The
+ * vectorized kernels reduce c*t modulo 2*PI exactly before any sine or
+ * cosine is taken. This is well below the truncation error of the theory.
+ */
+#define VSOP87_KERNEL_TOLERANCE	1E-10
+
+/*
+ * Largest difference in AU between vsop87_coordinates_fast() and
+ * vsop87_coordinates() within 4000 years of J2000, for any kernel. For each
+ * planet, the largest difference is
+ *
+ * Mercury 8E-8, Venus 1.4E-7, Earth 2E-7, Mars 3.2E-7,
+ * Jupiter 1.1E-6, Saturn 1.8E-6, Uranus 3.7E-6, Neptune 6.3E-6
+ *
+ * or about 0.03 arcseconds as seen from the Sun. It comes mostly from
+ * rounding the amplitudes to floats, and so grows with the size of the
+ * orbit rather than with the distance from J2000.
+ */
+#define VSOP87_FAST_TOLERANCE	1E-5
+
+/* Routines used to sum up the series in the theory */
+enum vsop87_kernel {
+	VSOP87_KERNEL_SCALAR,	/* One term at a time with cos() from libm */
+	VSOP87_KERNEL_SSE2,	/* Two terms at a time with SSE2 */
+	VSOP87_KERNEL_AVX2,	/* Four terms at a time with AVX2 & FMA */
+	VSOP87_KERNEL_AVX512,	/* Eight terms at a time with AVX-512 */
+	VSOP87_KERNEL_REPRODUCIBLE, /* Same bits on every CPU, see below */
+	VSOP87_KERNEL_GENERATED	/* Straight-line code, see below */
+};
+
+/*
+ * The results of VSOP87_KERNEL_SSE2, AVX2 & AVX512 differ in the last bits,
+ * since each adds up the terms in as many lanes as it has. The
+ * reproducible kernel always adds them up in 2 lanes in a fixed order and
+ * never fuses multiply-adds, and calculates sines & cosines without the C
+ * library. vsop87_coordinates(), _batch(), _fast(), _state(), _tol(),
+ * vsop87_snapshot() and the Earth cache then give the same bits on every
+ * CPU, for any number of threads and epochs per call, at about the speed of
+ * VSOP87_KERNEL_SSE2. elp82b_set_kernel() accepts it too.
+ */
+
+/*
+ * VSOP87_KERNEL_GENERATED is only supported when the library is built with
+ * 'make target=posix generated=1'. The makefile then writes every series of
+ * VSOP87 & ELP 2000-82B out as C, with the coefficients as constants, and
+ * compiles it into the library. vsop87_coordinates(), _batch() and
+ * vsop87_snapshot() without velocities, as well as elp82b_coordinates(), use
+ * that code. Everything else works as with VSOP87_KERNEL_REPRODUCIBLE. The
+ * series can be truncated by also passing vsop87_tolerance (AU) and
+ * elp82b_tolerance (arcseconds) to make. Terms are then dropped while the
+ * error stays within the tolerance, within 4000 years of J2000.
+ */
+
+/*
+ * A stepper calculates sin() and cos() of its arguments afresh every
+ * VSOP87_STEPPER_RESEED steps. Within 1E5 steps of any size up to 10 days,
+ * its coordinates agree with vsop87_coordinates() to within
+ * VSOP87_STEPPER_TOLERANCE AU.
+ */
+#define VSOP87_STEPPER_RESEED		1024
+#define VSOP87_STEPPER_TOLERANCE	1E-11
+
+/* State of a fixed-step evaluation. See vsop87_stepper_init(). */
+struct vsop87_stepper {
+	int planet;		/* The planet being calculated */
+	struct julian_date tdb;	/* The first epoch */
+	double step;		/* Interval between epochs in days */
+	long count;		/* Number of steps taken so far */
+	int freq_count;		/* Number of unique frequencies */
+	double *sn;		/* sin(c*t) for each frequency */
+	double *cs;		/* cos(c*t) for each frequency */
+	double *sd;		/* sin(c*step) for each frequency */
+	double *cd;		/* cos(c*step) for each frequency */
+};
+
+/*
+ * vsop87_geocentric_apparent() solves the light-time equation to within
+ * VSOP87_LIGHT_TIME_TOLERANCE AU of the planet's position. The attraction of
+ * the other planets on a planet and on the Sun, which its Keplerian orbit
+ * leaves out, is below VSOP87_LIGHT_TIME_PERTURBATION AU/day^2 for every
+ * planet but the Earth within 5000 years of J2000.
+ */
+#define VSOP87_LIGHT_TIME_TOLERANCE	1E-9
+#define VSOP87_LIGHT_TIME_PERTURBATION	4E-8
+
+/* Largest number of epochs kept by the Earth cache of a thread */
+#define VSOP87_EARTH_CACHE_MAX	16
+
+/* Selects planets for vsop87_snapshot() */
+#define VSOP87_PLANET_MASK(planet)	(1U << (planet))
+#define VSOP87_ALL_PLANETS		((1U << (NEPTUNE + 1)) - 1)
+
+/* Flags for vsop87_snapshot() */
+#define VSOP87_SNAPSHOT_VELOCITY	1	/* Calculate velocities too */
+#define VSOP87_SNAPSHOT_THREADS		2	/* One thread per CPU */
+
+/* Coordinates of several planets at one epoch. See vsop87_snapshot(). */
+struct vsop87_snapshot {
+	struct julian_date tdb;	/* The epoch */
+	unsigned int planets;	/* The planets calculated, always with EARTH */
+	int flags;		/* The flags passed to vsop87_snapshot() */
+	struct rectangular_coordinates pos[NEPTUNE + 1];  /* AU */
+	struct rectangular_coordinates vel[NEPTUNE + 1];  /* AU/day */
+};
+
+/*
+ * The coefficient arrays of every series are aligned to
+ * VSOP87_TERM_ALIGNMENT bytes and padded with zero terms to a multiple of
+ * VSOP87_TERM_PADDING terms.
+ */
+#define VSOP87_TERM_ALIGNMENT	64
+#define VSOP87_TERM_PADDING	8
+
+/* Used internally to store the series of terms a*cos(b + c*t) in the theory */
+struct vsop87_series {
+	int count;		/* Number of terms, not counting the padding */
+	const double *a;	/* Amplitudes */
+	const double *b;	/* Phases */
+	const double *c;	/* Frequencies */
+};
+
+/*
+ * Bodies in the VSOP87 tables loaded with vsop87_load(), in addition to the
+ * planets in enum solar_system_planets.
+ */
+#define VSOP87_EMB		(NEPTUNE + 1)	/* Earth-Moon barycenter */
+#define VSOP87_SUN		(NEPTUNE + 2)	/* The Sun (VSOP87E only) */
+#define VSOP87_BODY_COUNT	(NEPTUNE + 3)
+
+/* Each body has 6 series (powers of t) for each of its 3 variables */
+#define VSOP87_SERIES_PER_BODY	18
+
+/*
+ * A binary VSOP87 table file starts with a struct vsop87_file_header, in
+ * the byte order of the machine that wrote it. The coefficient arrays a[],
+ * b[] & c[] of every series follow one another at the offset given in its
+ * struct vsop87_file_series, which is a multiple of VSOP87_TERM_ALIGNMENT.
+ * Each array is padded with zero terms to a multiple of VSOP87_TERM_PADDING.
+ * Files are created from the original ASCII files of the theory by
+ * examples/vsop87_convert.
+ */
+#define VSOP87_FILE_MAGIC	"VSOP87K"
+#define VSOP87_FILE_FORMAT	1
+#define VSOP87_FILE_BYTE_ORDER	0x01020304
+
+struct vsop87_file_series {
+	int64_t offset;		/* Byte offset of a[] from the start of the file */
+	int32_t count;		/* Number of terms, not counting the padding */
+	int32_t padded;		/* Number of terms, counting the padding */
+};
+
+struct vsop87_file_header {
+	char magic[8];		/* VSOP87_FILE_MAGIC */
+	int32_t format;		/* VSOP87_FILE_FORMAT */
+	int32_t byte_order;	/* VSOP87_FILE_BYTE_ORDER */
+	int32_t version;	/* 'A' to 'E' */
+	int32_t bodies;		/* Bit (1 << body) is set for every body present */
+	struct vsop87_file_series series[VSOP87_BODY_COUNT][VSOP87_SERIES_PER_BODY];
+};
+
+/* A table of the theory loaded by vsop87_load() */
+struct vsop87_table {
+	char version;		/* 'A' to 'E' */
+	unsigned int bodies;	/* Bit (1 << body) is set for every body present */
+	struct vsop87_series series[VSOP87_BODY_COUNT][VSOP87_SERIES_PER_BODY];
+	void *map;		/* The mapped file */
+	size_t size;		/* Size of the mapped file */
+	void *factored;		/* Used internally */
 };
 
 int vsop87_coordinates(enum solar_system_planets planet, struct julian_date *tt,
 		struct rectangular_coordinates *pos);
 
+int vsop87_coordinates_batch(enum solar_system_planets planet,
+		const struct julian_date *tdb, size_t n,
+		struct rectangular_coordinates *pos);
+
+int vsop87_coordinates_fast(enum solar_system_planets planet,
+		const struct julian_date *tdb, size_t n,
+		struct rectangular_coordinates *pos);
+
+int vsop87_state(enum solar_system_planets planet, struct julian_date *tdb,
+		struct rectangular_coordinates *pos,
+		struct rectangular_coordinates *vel);
+
+int vsop87_geocentric_apparent(enum solar_system_planets planet,
+		struct julian_date *tdb, struct rectangular_coordinates *pos,
+		double *dist);
+
+int vsop87_snapshot(struct julian_date *tdb, unsigned int planets, int flags,
+		struct vsop87_snapshot *snap);
+
+int vsop87_earth_cache(unsigned int entries);
+
+void vsop87_earth_cache_stats(unsigned long *hits, unsigned long *misses);
+
+int vsop87_coordinates_tol(enum solar_system_planets planet,
+		struct julian_date *tdb, double tolerance,
+		struct rectangular_coordinates *pos, double *bound);
+
+int vsop87_load(const char *path, char version, struct vsop87_table **table);
+
+int vsop87_table_state(struct vsop87_table *table, int body,
+		struct julian_date *tdb, double var[3], double rate[3]);
+
+void vsop87_unload(struct vsop87_table *table);
+
+int vsop87_set_kernel(enum vsop87_kernel kernel);
+
+enum vsop87_kernel vsop87_get_kernel(void);
+
+int vsop87_stepper_init(struct vsop87_stepper *st,
+		enum solar_system_planets planet, struct julian_date *tdb,
+		double step);
+
+void vsop87_stepper_next(struct vsop87_stepper *st,
+		struct rectangular_coordinates *pos);
+
+void vsop87_stepper_free(struct vsop87_stepper *st);
+
 void vsop87_ecliptic_to_equator(struct rectangular_coordinates *pos);
 
 #endif
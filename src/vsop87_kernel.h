@@ -0,0 +1,523 @@
+/*
+ * vsop87_kernel.h - Vectorized series summation for the VSOP87 theory
+ * Copyright (C) 2016 Shiva Iyer <shiva.iyer AT g m a i l DOT c o m>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file is not a regular header. vsop87.c includes it once for every
+ * instruction set it supports, after defining the following macros:
+ *
+ * KERNEL_SUFFIX -- Appended to the name of every function defined here.
+ * KERNEL_TARGET -- Instruction set string passed to the GCC target attribute.
+ *                  If it is not defined, the functions are compiled for any
+ *                  CPU, without contracting a*b + c into fused multiply-adds,
+ *                  so that every lane is rounded the same way everywhere.
+ *                  They are also marked unused, as the includer may not
+ *                  need them all.
+ * KERNEL_WIDTH  -- Number of doubles in a vector register.
+ *
+ * The macros are undefined again at the end of the file.
+ */
+
+#ifndef KERNEL_ROUND_MAGIC
+
+/* Adding 1.5*2^52 rounds a double to the nearest integer */
+#define KERNEL_ROUND_MAGIC	6755399441055744.0
+#define KERNEL_2_OVER_PI	0.636619772367581343076
+
+/* PI/2 split into three parts of 33 bits each (from fdlibm) */
+#define KERNEL_PIO2_1		1.57079632673412561417E+00
+#define KERNEL_PIO2_2		6.07710050630396597660E-11
+#define KERNEL_PIO2_3		2.02226624871116645580E-21
+
+/* Lists the elements of x at the first 2, 4, 8 or 16 indices in f */
+#define KERNEL_GATHER2(x, f)	x[(f)[0]], x[(f)[1]]
+#define KERNEL_GATHER4(x, f)	KERNEL_GATHER2(x, f), KERNEL_GATHER2(x, (f) + 2)
+#define KERNEL_GATHER8(x, f)	KERNEL_GATHER4(x, f), KERNEL_GATHER4(x, (f) + 4)
+#define KERNEL_GATHER16(x, f)	KERNEL_GATHER8(x, f), KERNEL_GATHER8(x, (f) + 8)
+
+#endif
+
+#define KERNEL_CAT2(a, b)	a##_##b
+#define KERNEL_CAT(a, b)	KERNEL_CAT2(a, b)
+#define KERNEL(name)		KERNEL_CAT(name, KERNEL_SUFFIX)
+#ifdef KERNEL_TARGET
+#define KERNEL_ATTR		__attribute__((target(KERNEL_TARGET)))
+#else
+#define KERNEL_ATTR		__attribute__((optimize("fp-contract=off"), unused))
+#endif
+
+/*
+ * Loads the elements of x at the indices in f into a vector of doubles, or
+ * of floats with KERNEL_GATHERF.
+ */
+#if KERNEL_WIDTH == 2
+#define KERNEL_GATHER(x, f)	(KERNEL(vdouble)){KERNEL_GATHER2(x, f)}
+#define KERNEL_GATHERF(x, f)	(KERNEL(vfloat)){KERNEL_GATHER4(x, f)}
+#elif KERNEL_WIDTH == 4
+#define KERNEL_GATHER(x, f)	(KERNEL(vdouble)){KERNEL_GATHER4(x, f)}
+#define KERNEL_GATHERF(x, f)	(KERNEL(vfloat)){KERNEL_GATHER8(x, f)}
+#else
+#define KERNEL_GATHER(x, f)	(KERNEL(vdouble)){KERNEL_GATHER8(x, f)}
+#define KERNEL_GATHERF(x, f)	(KERNEL(vfloat)){KERNEL_GATHER16(x, f)}
+#endif
+
+typedef double KERNEL(vdouble) __attribute__((vector_size(8 * KERNEL_WIDTH)));
+typedef long long KERNEL(vlong) __attribute__((vector_size(8 * KERNEL_WIDTH)));
+
+/*
+ * The single precision kernels use vectors of twice as many floats, whose
+ * arguments are reduced in vectors of as many doubles.
+ */
+typedef float KERNEL(vfloat) __attribute__((vector_size(8 * KERNEL_WIDTH)));
+typedef int KERNEL(vint) __attribute__((vector_size(8 * KERNEL_WIDTH)));
+typedef double KERNEL(vdouble2) __attribute__((vector_size(16 * KERNEL_WIDTH)));
+typedef long long KERNEL(vlong2)
+	__attribute__((vector_size(16 * KERNEL_WIDTH)));
+
+/*
+ * Vector version of sincos(). The argument is reduced to [-PI/4, PI/4] with
+ * a three part Cody-Waite reduction by PI/2, which is exact for |x| < 1.6E6
+ * radians. The reduced argument is then passed to the minimax polynomials
+ * for sin() and cos() from the Cephes library. The absolute error is below
+ * 1E-15 over the range of arguments used by the theory.
+ *
+ * x -- The arguments in radians.
+ * sinx -- The sines of the arguments.
+ * cosx -- The cosines of the arguments.
+ */
+static __inline__ KERNEL_ATTR void KERNEL(vsincos)(KERNEL(vdouble) x,
+		KERNEL(vdouble) *sinx, KERNEL(vdouble) *cosx)
+{
+	KERNEL(vdouble) k,r,r2,s,c;
+	KERNEL(vlong) q,swap,sign;
+
+	/* Round x*2/PI to the nearest integer, keeping its bits in q */
+	k = x * KERNEL_2_OVER_PI + KERNEL_ROUND_MAGIC;
+	q = (KERNEL(vlong))k;
+	k = k - KERNEL_ROUND_MAGIC;
+
+	r = ((x - k * KERNEL_PIO2_1) - k * KERNEL_PIO2_2) - k * KERNEL_PIO2_3;
+	r2 = r * r;
+
+	s = r + r * r2 * (((((1.58962301576546568060E-10 * r2 +
+		-2.50507477628578072866E-8) * r2 +
+		2.75573136213857245213E-6) * r2 +
+		-1.98412698295895385996E-4) * r2 +
+		8.33333333332211858878E-3) * r2 +
+		-1.66666666666666307295E-1);
+
+	c = 1.0 - 0.5 * r2 + r2 * r2 * (((((-1.13585365213876817300E-11 * r2 +
+		2.08757008419747316778E-9) * r2 +
+		-2.75573141792967388112E-7) * r2 +
+		2.48015872888517045348E-5) * r2 +
+		-1.38888888888730564116E-3) * r2 +
+		4.16666666666665929218E-2);
+
+	/*
+	 * sin(r + q*PI/2) is sin(r), cos(r), -sin(r), -cos(r) and
+	 * cos(r + q*PI/2) is cos(r), -sin(r), -cos(r), sin(r) for q = 0..3.
+	 * swap exchanges sin(r) and cos(r) for odd q, and sign flips the
+	 * results for the quadrants where they are negative.
+	 */
+	swap = -(q & 1);
+	sign = (q & 2) << 62;
+	*sinx = (KERNEL(vdouble))((((KERNEL(vlong))c & swap) |
+		((KERNEL(vlong))s & ~swap)) ^ sign);
+
+	sign = ((q + 1) & 2) << 62;
+	*cosx = (KERNEL(vdouble))((((KERNEL(vlong))s & swap) |
+		((KERNEL(vlong))c & ~swap)) ^ sign);
+}
+
+/*
+ * Vector version of cos(). See vsincos() for details.
+ *
+ * x -- The arguments in radians.
+ *
+ * Return: The cosines of the arguments.
+ */
+static __inline__ KERNEL_ATTR KERNEL(vdouble) KERNEL(vcos)(KERNEL(vdouble) x)
+{
+	KERNEL(vdouble) s,c;
+
+	KERNEL(vsincos)(x, &s, &c);
+	return c;
+}
+
+/*
+ * Adds the terms a*cos(b + c*t) of a series to the sums for a block of
+ * epochs. KERNEL_WIDTH terms are evaluated at once, and each group of terms
+ * is applied to every epoch in the block before moving on to the next.
+ *
+ * s -- The series.
+ * t -- The epochs in Julian millennia from J2000.
+ * m -- The number of epochs in t. At most VSOP87_BLOCK_SIZE.
+ * sum -- The sum for each epoch, updated in-place.
+ */
+static KERNEL_ATTR void KERNEL(series_sum)(const struct vsop87_series *s,
+		const double *t, int m, double *sum)
+{
+	int i,j,l;
+	KERNEL(vdouble) a,b,c,acc[VSOP87_BLOCK_SIZE];
+
+	for (j = 0; j < m; j++)
+		acc[j] = (KERNEL(vdouble)){0};
+
+	/* The padding terms past the end of the series contribute 0*cos(0) */
+	for (i = 0; i < s->count; i += KERNEL_WIDTH) {
+		memcpy(&a, s->a + i, sizeof(a));
+		memcpy(&b, s->b + i, sizeof(b));
+		memcpy(&c, s->c + i, sizeof(c));
+
+		for (j = 0; j < m; j++)
+			acc[j] += a * KERNEL(vcos)(b + c * t[j]);
+	}
+
+	for (j = 0; j < m; j++) {
+		for (l = 0; l < KERNEL_WIDTH; l++)
+			sum[j] += acc[j][l];
+	}
+}
+
+/*
+ * Reduces c*t modulo 2*PI for a table of frequencies at one epoch, as
+ * reduce_argument() in arg_reduction.h does.
+ *
+ * hi -- The leading bits of each frequency in radians per day. The table is
+ *       padded to a multiple of KERNEL_WIDTH.
+ * lo -- The rest of each frequency.
+ * n -- The number of frequencies, including the padding.
+ * whole -- The whole number of days of the epoch from J2000.
+ * frac -- The rest of the epoch in days.
+ * x -- The reduced arguments, n elements.
+ */
+static KERNEL_ATTR void KERNEL(reduce_table)(const double *hi,
+		const double *lo, int n, double whole, double frac, double *x)
+{
+	int i;
+	KERNEL(vdouble) h,l,y,k;
+
+	for (i = 0; i < n; i += KERNEL_WIDTH) {
+		memcpy(&h, hi + i, sizeof(h));
+		memcpy(&l, lo + i, sizeof(l));
+		y = h * whole;
+		k = y * REDUCTION_1_OVER_2PI + KERNEL_ROUND_MAGIC;
+		k = k - KERNEL_ROUND_MAGIC;
+		y = ((y - k * REDUCTION_2PI_1) - k * REDUCTION_2PI_2) -
+			k * REDUCTION_2PI_3 + (l * whole + (h + l) * frac);
+		memcpy(x + i, &y, sizeof(y));
+	}
+}
+
+/*
+ * Reduces c*t modulo 2*PI for a table of frequencies at m epochs. The m
+ * arguments of each frequency are stored one after another, so that
+ * sincos_table() turns them into the layout used by factored_block().
+ *
+ * hi, lo -- The frequencies, as for reduce_table().
+ * n -- The number of frequencies.
+ * whole, frac -- The m epochs, as for reduce_table().
+ * m -- The number of epochs, a multiple of KERNEL_WIDTH.
+ * x -- The reduced arguments, n*m elements.
+ */
+static KERNEL_ATTR void KERNEL(reduce_block)(const double *hi,
+		const double *lo, int n, const double *whole, const double *frac,
+		int m, double *x)
+{
+	int i,j;
+	KERNEL(vdouble) w,f,y,k;
+
+	for (j = 0; j < m; j += KERNEL_WIDTH) {
+		memcpy(&w, whole + j, sizeof(w));
+		memcpy(&f, frac + j, sizeof(f));
+		for (i = 0; i < n; i++) {
+			y = hi[i] * w;
+			k = y * REDUCTION_1_OVER_2PI + KERNEL_ROUND_MAGIC;
+			k = k - KERNEL_ROUND_MAGIC;
+			y = ((y - k * REDUCTION_2PI_1) - k * REDUCTION_2PI_2) -
+				k * REDUCTION_2PI_3 + (lo[i] * w + (hi[i] + lo[i]) * f);
+			memcpy(x + i * m + j, &y, sizeof(y));
+		}
+	}
+}
+
+/*
+ * Calculates the sines and cosines of a table of arguments, usually
+ * reduced by reduce_table() or reduce_block().
+ *
+ * x -- The arguments. The table is padded to a multiple of KERNEL_WIDTH.
+ * n -- The number of arguments in x, including the padding.
+ * sn -- The sines, n elements.
+ * cs -- The cosines, n elements.
+ */
+static KERNEL_ATTR void KERNEL(sincos_table)(const double *x, int n,
+		double *sn, double *cs)
+{
+	int i;
+	KERNEL(vdouble) y,s,c;
+
+	for (i = 0; i < n; i += KERNEL_WIDTH) {
+		memcpy(&y, x + i, sizeof(y));
+		KERNEL(vsincos)(y, &s, &c);
+		memcpy(sn + i, &s, sizeof(s));
+		memcpy(cs + i, &c, sizeof(c));
+	}
+}
+
+/*
+ * Sums up a series whose terms a*cos(b + c*t) have been factored as
+ * ac*cos(c*t) - as*sin(c*t), with ac = a*cos(b) and as = a*sin(b).
+ *
+ * ac -- a*cos(b) for each term.
+ * as -- a*sin(b) for each term.
+ * f -- The index of each term's frequency in sn and cs.
+ * n -- The number of terms, padded to a multiple of KERNEL_WIDTH.
+ * sn -- sin(c*t) for each frequency.
+ * cs -- cos(c*t) for each frequency.
+ *
+ * Return: The sum of the series.
+ */
+static KERNEL_ATTR double KERNEL(factored_sum)(const double *ac,
+		const double *as, const int *f, int n, const double *sn,
+		const double *cs)
+{
+	int i,l;
+	double sum;
+	KERNEL(vdouble) a,b,acc;
+
+	acc = (KERNEL(vdouble)){0};
+	for (i = 0; i < n; i += KERNEL_WIDTH) {
+		memcpy(&a, ac + i, sizeof(a));
+		memcpy(&b, as + i, sizeof(b));
+		acc += a * KERNEL_GATHER(cs, f + i) - b * KERNEL_GATHER(sn, f + i);
+	}
+
+	sum = 0;
+	for (l = 0; l < KERNEL_WIDTH; l++)
+		sum += acc[l];
+
+	return sum;
+}
+
+/*
+ * Sums up a factored series and its derivative with respect to t in the
+ * same pass. The derivative of each term is -c*(ac*sin(c*t) + as*cos(c*t)).
+ *
+ * ac, as, f, n, sn, cs -- As for factored_sum().
+ * freq -- The frequency c at each index in sn and cs.
+ * deriv -- The derivative of the series.
+ *
+ * Return: The sum of the series.
+ */
+static KERNEL_ATTR double KERNEL(factored_state)(const double *ac,
+		const double *as, const int *f, int n, const double *freq,
+		const double *sn, const double *cs, double *deriv)
+{
+	int i,l;
+	double sum;
+	KERNEL(vdouble) a,b,s,c,acc,dacc;
+
+	acc = (KERNEL(vdouble)){0};
+	dacc = (KERNEL(vdouble)){0};
+	for (i = 0; i < n; i += KERNEL_WIDTH) {
+		memcpy(&a, ac + i, sizeof(a));
+		memcpy(&b, as + i, sizeof(b));
+		s = KERNEL_GATHER(sn, f + i);
+		c = KERNEL_GATHER(cs, f + i);
+		acc += a * c - b * s;
+		dacc -= KERNEL_GATHER(freq, f + i) * (a * s + b * c);
+	}
+
+	sum = 0;
+	*deriv = 0;
+	for (l = 0; l < KERNEL_WIDTH; l++) {
+		sum += acc[l];
+		*deriv += dacc[l];
+	}
+
+	return sum;
+}
+
+/*
+ * Sums up a factored series at KERNEL_WIDTH epochs at once, using the
+ * sines and cosines of the arguments from reduce_block(). See
+ * factored_sum() for details.
+ *
+ * ac -- a*cos(b) for each term.
+ * as -- a*sin(b) for each term.
+ * f -- The index of each term's frequency in sn and cs.
+ * n -- The number of terms.
+ * sn -- sin(c*t) for each frequency and epoch.
+ * cs -- cos(c*t) for each frequency and epoch.
+ * sum -- The KERNEL_WIDTH sums of the series.
+ */
+static KERNEL_ATTR void KERNEL(factored_block)(const double *ac,
+		const double *as, const int *f, int n, const double *sn,
+		const double *cs, double *sum)
+{
+	int i;
+	KERNEL(vdouble) s,c,acc;
+
+	acc = (KERNEL(vdouble)){0};
+	for (i = 0; i < n; i++) {
+		memcpy(&s, sn + f[i] * KERNEL_WIDTH, sizeof(s));
+		memcpy(&c, cs + f[i] * KERNEL_WIDTH, sizeof(c));
+		acc += ac[i] * c - as[i] * s;
+	}
+
+	memcpy(sum, &acc, sizeof(acc));
+}
+
+/*
+ * Single precision version of vsincos(). The argument is reduced to
+ * [-PI/4, PI/4] in double precision as in vsincos(), so that it stays
+ * accurate for the large values of c*t far from J2000. Only the reduced
+ * argument is rounded to a float and passed to the minimax polynomials for
+ * sinf() and cosf() from the Cephes library. The absolute error is below
+ * 1E-7.
+ *
+ * x -- The arguments in radians.
+ * sinx -- The sines of the arguments.
+ * cosx -- The cosines of the arguments.
+ */
+static __inline__ KERNEL_ATTR void KERNEL(vsincosf)(KERNEL(vdouble2) x,
+		KERNEL(vfloat) *sinx, KERNEL(vfloat) *cosx)
+{
+	KERNEL(vdouble2) k;
+	KERNEL(vfloat) r,r2,s,c;
+	KERNEL(vint) q,swap,sign;
+
+	k = x * KERNEL_2_OVER_PI + KERNEL_ROUND_MAGIC;
+	q = __builtin_convertvector((KERNEL(vlong2))k, KERNEL(vint));
+	k = k - KERNEL_ROUND_MAGIC;
+
+	r = __builtin_convertvector(((x - k * KERNEL_PIO2_1) -
+		k * KERNEL_PIO2_2) - k * KERNEL_PIO2_3, KERNEL(vfloat));
+	r2 = r * r;
+
+	s = r + r * r2 * ((-1.9515295891E-4f * r2 + 8.3321608736E-3f) * r2 +
+		-1.6666654611E-1f);
+
+	c = 1.0f - 0.5f * r2 + r2 * r2 * ((2.443315711809948E-5f * r2 +
+		-1.388731625493765E-3f) * r2 + 4.166664568298827E-2f);
+
+	/* See vsincos() */
+	swap = -(q & 1);
+	sign = (q & 2) << 30;
+	*sinx = (KERNEL(vfloat))((((KERNEL(vint))c & swap) |
+		((KERNEL(vint))s & ~swap)) ^ sign);
+
+	sign = ((q + 1) & 2) << 30;
+	*cosx = (KERNEL(vfloat))((((KERNEL(vint))s & swap) |
+		((KERNEL(vint))c & ~swap)) ^ sign);
+}
+
+/*
+ * Single precision version of sincos_table(). The arguments stay in double
+ * precision.
+ *
+ * x -- The arguments. The table is padded to a multiple of 2*KERNEL_WIDTH.
+ * n -- The number of arguments in x, including the padding.
+ * sn -- The sines, n elements.
+ * cs -- The cosines, n elements.
+ */
+static KERNEL_ATTR void KERNEL(sincos_table_f)(const double *x, int n,
+		float *sn, float *cs)
+{
+	int i;
+	KERNEL(vdouble2) y;
+	KERNEL(vfloat) s,c;
+
+	for (i = 0; i < n; i += 2 * KERNEL_WIDTH) {
+		memcpy(&y, x + i, sizeof(y));
+		KERNEL(vsincosf)(y, &s, &c);
+		memcpy(sn + i, &s, sizeof(s));
+		memcpy(cs + i, &c, sizeof(c));
+	}
+}
+
+/*
+ * Single precision version of factored_sum(). The terms are added from the
+ * end of the series, where the amplitudes are smallest, so that the
+ * rounding errors of the float accumulators stay small. The lanes are
+ * added up in double precision.
+ *
+ * ac, as, f, n, sn, cs -- As for factored_sum(). n is a multiple of
+ *                         2*KERNEL_WIDTH.
+ *
+ * Return: The sum of the series.
+ */
+static KERNEL_ATTR double KERNEL(factored_sum_f)(const float *ac,
+		const float *as, const int *f, int n, const float *sn,
+		const float *cs)
+{
+	int i,l;
+	double sum;
+	KERNEL(vfloat) a,b,acc;
+
+	acc = (KERNEL(vfloat)){0};
+	for (i = n - 2 * KERNEL_WIDTH; i >= 0; i -= 2 * KERNEL_WIDTH) {
+		memcpy(&a, ac + i, sizeof(a));
+		memcpy(&b, as + i, sizeof(b));
+		acc += a * KERNEL_GATHERF(cs, f + i) - b * KERNEL_GATHERF(sn, f + i);
+	}
+
+	sum = 0;
+	for (l = 0; l < 2 * KERNEL_WIDTH; l++)
+		sum += acc[l];
+
+	return sum;
+}
+
+/*
+ * Single precision version of factored_block(), for 2*KERNEL_WIDTH epochs
+ * at once. The terms are added from the end of the series as in
+ * factored_sum_f().
+ *
+ * ac, as, f, n -- As for factored_sum_f().
+ * sn -- sin(c*t) for each frequency and epoch, from reduce_block() and
+ *       sincos_table_f().
+ * cs -- cos(c*t) for each frequency and epoch.
+ * sum -- The 2*KERNEL_WIDTH sums of the series.
+ */
+static KERNEL_ATTR void KERNEL(factored_block_f)(const float *ac,
+		const float *as, const int *f, int n, const float *sn,
+		const float *cs, double *sum)
+{
+	int i,l;
+	KERNEL(vfloat) s,c,acc;
+
+	acc = (KERNEL(vfloat)){0};
+	for (i = n - 1; i >= 0; i--) {
+		memcpy(&s, sn + f[i] * 2 * KERNEL_WIDTH, sizeof(s));
+		memcpy(&c, cs + f[i] * 2 * KERNEL_WIDTH, sizeof(c));
+		acc += ac[i] * c - as[i] * s;
+	}
+
+	for (l = 0; l < 2 * KERNEL_WIDTH; l++)
+		sum[l] = acc[l];
+}
+
+#undef KERNEL_CAT2
+#undef KERNEL_CAT
+#undef KERNEL
+#undef KERNEL_ATTR
+#undef KERNEL_GATHER
+#undef KERNEL_GATHERF
+#undef KERNEL_SUFFIX
+#undef KERNEL_TARGET
+#undef KERNEL_WIDTH